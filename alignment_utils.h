@@ -17,11 +17,54 @@
 */
 #define MMAP_THRESHOLD (128 * 1024)
 /*
-    Method that aligned a given size to a multiple of ALIGNMENT
+    Size of a cache line, the unit of isolation of OS_HINT_ISOLATED blocks
 */
-int align(size_t size);
+#define CACHE_LINE_SIZE 64
+/*
+    Size of the chunk each thread carves isolated blocks from and largest
+    isolated block carved from it.
+*/
+#define ISOLATED_CHUNK_SIZE 4096
+#define ISOLATED_CARVE_MAX  1024
+/*
+    Number of per-thread lists of freed isolated blocks, one for each
+    number of cache lines a carved block can span.
+*/
+#define ISOLATED_CLASSES (ISOLATED_CARVE_MAX / CACHE_LINE_SIZE)
+/*
+    Number of large enough free blocks examined by the good fit policy
+    before it settles for the best one seen.
+*/
+#define GOOD_FIT_DEPTH 8
+/*
+    Number of times a block has to be grown by realloc() before it
+    receives geometric headroom.
+*/
+#define REALLOC_GROWTH_THRESHOLD 2
+/*
+    Method that aligned a given size to a multiple of ALIGNMENT. It is
+    inlined and uses a mask, since ALIGNMENT is a power of 2.
+*/
+static inline size_t align(size_t size)
+{
+	return (size + ALIGNMENT - 1) & ~((size_t)ALIGNMENT - 1);
+}
 /*
     Returns the aligned number of bytes ocupied by the header of one
     block in the memory allocator's linked list.
 */
-int get_block_meta_size(void);
+static inline size_t get_block_meta_size(void)
+{
+	return align(sizeof(struct block_meta));
+}
+/*
+    Rounds the aligned size of an isolated block so that, with its payload
+    starting on a cache line, the payload fills whole lines and one more
+    line is reserved for padding and the header of the next block, whose
+    status is written by other threads.
+*/
+static inline size_t isolated_size(size_t size)
+{
+	return ((size + CACHE_LINE_SIZE - 1) & ~((size_t)CACHE_LINE_SIZE - 1))
+			+ CACHE_LINE_SIZE - get_block_meta_size();
+}
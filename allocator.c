@@ -4,95 +4,526 @@
  * @date 10.04.2023
  * @for  Operating Systems - Memory Allocator
  */
+#define _GNU_SOURCE
+#include <stdint.h>
 #include <unistd.h>
 #include "allocator.h"
 #include "alignment_utils.h"
 #include "helpers.h"
+#include "osmem.h"
+#include "profile.h"
+#include "meta_table.h"
+#include "scavenger.h"
 
 /**
  * Heap head - start of the linked list
  */
 struct block_meta *heap_head;
+/**
+ * Last block alloced using brk() syscall. Since brk() blocks are always
+ * placed before mapped ones, the brk() part of the list is the range
+ * [heap_head, heap_last] and heap scans never need to touch mapped headers.
+ */
+struct block_meta *heap_last;
 /**
  * Value set when the list is first used
  */
 short int initialised;
 /**
- * @param size - aligned size of the new block
- *	| This method is used when allocating a chunk of memory
- *	| that is larger than the MMAP_TRESHOLD.
+ * Fit policy used for block reuse, one of the OS_FIT_* values. It is
+ * read from the OSMEM_FIT_POLICY environment variable on first use,
+ * unless set_fit_policy() was called before.
+ */
+int fit_policy = -1;
+/**
+ * Roving pointer of the next fit policy - the block where the previous
+ * search stopped.
+ */
+struct block_meta *fit_rover;
+
+/**
+ * | Returns the first block after the brk() part of the list, used as
+ * | the end marker when iterating through brk() alloced blocks.
+ */
+struct block_meta *brk_end(void)
+{
+	return heap_last != NULL ? heap_last->next : heap_head;
+}
+
+/**
+ * @param block - block that absorbs the next one
+ *	| Merges the block following the given one into it and keeps
+ *	| heap_last valid if the absorbed block was the last brk() block.
+ */
+static void merge_next(struct block_meta *block)
+{
+	struct block_meta *next_block = block->next;
+
+	merge_stamps(block, next_block);
+	block->size += next_block->size + get_block_meta_size();
+	block->next = next_block->next;
+	if (next_block == heap_last)
+		heap_last = block;
+	if (next_block == fit_rover)
+		fit_rover = block;
+	meta_table_erase(next_block);
+	meta_table_sync(block);
+}
+
+/**
+ * @param block - brk() block or NULL
+ *	| Returns the first free brk() block after the given one, or from
+ *	| the heap head for NULL, and NULL when there is none. With side
+ *	| tables the walk only reads the tables, the headers of alloced
+ *	| blocks are skipped without being touched. (A)
+ */
+static struct block_meta *next_free_block(struct block_meta *block)
+{
+	// (A)
+	if (meta_table_enabled)
+		return meta_table_next_free(block);
+
+	for (block = block != NULL ? block->next : heap_head; block != brk_end(); block = block->next) {
+		if (block->status == STATUS_FREE)
+			return block;
+	}
+	return NULL;
+}
+
+/**
+ * @param block - free brk() block
+ *	| Returns the size of the block, read from the side tables when
+ *	| they are used so that the header isn't touched.
+ */
+static size_t free_block_size(struct block_meta *block)
+{
+	if (meta_table_enabled)
+		return meta_table_size(block);
+	return block->size;
+}
+
+/**
+ * @param block - free block
+ * @param stop - block that must not be absorbed
+ *	| Merges the run of free blocks following the given one into it.
+ *	| With side tables, the header is only read if the next block is free.
+ *	| Runs that are merged are timed as PHASE_COALESCE, nested in the
+ *	| fit search that walks the list.
+ */
+static void merge_free_run(struct block_meta *block, struct block_meta *stop)
+{
+	if (meta_table_enabled && !meta_table_next_is_free(block))
+		return;
+	if (block->next == brk_end() || block->next == stop || block->next->status != STATUS_FREE)
+		return;
+
+	PROFILE_BEGIN(sample);
+	do {
+		merge_next(block);
+	} while (block->next != brk_end() && block->next != stop && block->next->status == STATUS_FREE);
+	PROFILE_END(PHASE_COALESCE, sample);
+}
+
+/**
+ * | Returns the fit policy, reading it from the environment the
+ * | first time it is needed.
+ */
+static int get_fit_policy(void)
+{
+	if (fit_policy == -1) {
+		char *name = getenv("OSMEM_FIT_POLICY");
+
+		fit_policy = OS_FIT_BEST;
+		if (name != NULL && strcmp(name, "first") == 0)
+			fit_policy = OS_FIT_FIRST;
+		else if (name != NULL && strcmp(name, "next") == 0)
+			fit_policy = OS_FIT_NEXT;
+		else if (name != NULL && strcmp(name, "good") == 0)
+			fit_policy = OS_FIT_GOOD;
+	}
+	return fit_policy;
+}
+
+/**
+ * @param size - aligned size of the requested chunk
+ *	| Single pass over the brk() part of the list that merges each run
+ *	| of adjacent free blocks (A) and keeps the smallest merged block
+ *	| large enough for the given size (B). Fusing coalescing with the
+ *	| search means every header is read only once per call.
+ */
+static struct block_meta *best_fit_search(size_t size)
+{
+	struct block_meta *best_fit = NULL;
+	struct block_meta *ptr = NULL;
+	size_t best_size = 0;
+
+	for (ptr = next_free_block(NULL); ptr != NULL; ptr = next_free_block(ptr)) {
+		// (A)
+		merge_free_run(ptr, NULL);
+		// (B)
+		size_t ptr_size = free_block_size(ptr);
+
+		if (ptr_size >= size && (best_fit == NULL || best_size > ptr_size)) {
+			best_fit = ptr;
+			best_size = ptr_size;
+		}
+	}
+	return best_fit;
+}
+
+/**
+ * @param size - aligned size of the requested chunk
+ *	| Returns the first free block large enough for the given size,
+ *	| merging free runs only up to the point where it stops.
+ */
+static struct block_meta *first_fit_search(size_t size)
+{
+	for (struct block_meta *ptr = next_free_block(NULL); ptr != NULL; ptr = next_free_block(ptr)) {
+		merge_free_run(ptr, NULL);
+		if (free_block_size(ptr) >= size)
+			return ptr;
+	}
+	return NULL;
+}
+
+/**
+ * @param size - aligned size of the requested chunk
+ *	| Same as first fit, but the search starts from the block where the
+ *	| previous one stopped (A) and wraps around to the heap head. (B)
+ *	| The start block is never absorbed by a merge, so the second part
+ *	| of the search ends when it gets back to it. (C)
+ */
+static struct block_meta *next_fit_search(size_t size)
+{
+	if (heap_last == NULL)
+		return NULL;
+
+	// (A)
+	struct block_meta *start = fit_rover != NULL ? fit_rover : heap_head;
+	struct block_meta *ptr = start->status == STATUS_FREE ? start : next_free_block(start);
+
+	for (; ptr != NULL; ptr = next_free_block(ptr)) {
+		merge_free_run(ptr, NULL);
+		if (free_block_size(ptr) >= size) {
+			fit_rover = ptr;
+			return ptr;
+		}
+	}
+
+	// (B)
+	for (ptr = next_free_block(NULL); ptr != NULL && ptr < start; ptr = next_free_block(ptr)) {
+		// (C)
+		merge_free_run(ptr, start);
+		if (free_block_size(ptr) >= size) {
+			fit_rover = ptr;
+			return ptr;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @param size - aligned size of the requested chunk
+ *	| Good fit: a free block is accepted at once if it wastes at most an
+ *	| eighth of the requested size, i.e. it falls in the same size bin (A).
+ *	| Otherwise the best block seen is returned after GOOD_FIT_DEPTH
+ *	| large enough candidates were examined. (B)
+ */
+static struct block_meta *good_fit_search(size_t size)
+{
+	struct block_meta *best_fit = NULL;
+	size_t best_size = 0;
+	int candidates = 0;
+
+	for (struct block_meta *ptr = next_free_block(NULL); ptr != NULL; ptr = next_free_block(ptr)) {
+		merge_free_run(ptr, NULL);
+
+		size_t ptr_size = free_block_size(ptr);
+
+		if (ptr_size < size)
+			continue;
+		// (A)
+		if (ptr_size - size <= size / 8)
+			return ptr;
+		if (best_fit == NULL || best_size > ptr_size) {
+			best_fit = ptr;
+			best_size = ptr_size;
+		}
+		// (B)
+		if (++candidates == GOOD_FIT_DEPTH)
+			break;
+	}
+	return best_fit;
+}
+
+/**
+ * @param size - aligned size of the requested chunk
+ *	| Searches a free block for the given size using the current
+ *	| fit policy.
+ */
+static struct block_meta *fit_search(size_t size)
+{
+	struct block_meta *found;
+
+	meta_table_check_env();
+	PROFILE_BEGIN(sample);
+	switch (get_fit_policy()) {
+	case OS_FIT_FIRST:
+		found = first_fit_search(size);
+		break;
+	case OS_FIT_NEXT:
+		found = next_fit_search(size);
+		break;
+	case OS_FIT_GOOD:
+		found = good_fit_search(size);
+		break;
+	default:
+		found = best_fit_search(size);
+		break;
+	}
+	PROFILE_END(PHASE_FIT_SEARCH, sample);
+	return found;
+}
+
+/**
+ * @param policy - one of the OS_FIT_* values
+ *	| Sets the fit policy used for block reuse.
+ */
+void set_fit_policy(int policy)
+{
+	fit_policy = policy;
+	fit_rover = NULL;
+}
+/**
+ * @param new_block - header of a new mapping, with its size set
  *	| Case (A): The block is the first one in the list, in
  *	|			which case it becomes the heap head.
  *	| Case (B): The block is added at the end of the list.
- *	| Returns the memory moved with size_of_header bytes
  */
-void *add_new_mapped_block(size_t size)
+static void append_mapped_block(struct block_meta *new_block)
 {
-	void *new_mem = NULL;
-
-	new_mem = mmap(NULL, size + get_block_meta_size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
-	DIE(new_mem == (void *) -1, "Mmap syscall failed!\n");
-
-	struct block_meta *new_block = new_mem, *ptr = NULL;
+	struct block_meta *ptr = NULL;
 
 	new_block->status = STATUS_MAPPED;
-	new_block->size = size;
+	new_block->grow_count = 0;
 	new_block->next = NULL;
 
 	if (heap_head == NULL) {
 		// (A)
 		initialised = 1;
-		heap_head = new_mem;
-		heap_head->size = size;
-		heap_head->next = NULL;
-		heap_head->status = STATUS_MAPPED;
+		heap_head = new_block;
 	} else {
 		// (B)
-		ptr = heap_head;
+		ptr = heap_last != NULL ? heap_last : heap_head;
 
 		while (ptr->next != NULL)
 			ptr = ptr->next;
 		ptr->next = new_block;
 	}
+}
+
+/**
+ * @param size - aligned size of the new block
+ *	| This method is used when allocating a chunk of memory
+ *	| that is larger than the MMAP_TRESHOLD. The block is added
+ *	| to the list by append_mapped_block().
+ *	| Returns the memory moved with size_of_header bytes
+ */
+void *add_new_mapped_block(size_t size)
+{
+	void *new_mem = NULL;
+
+	PROFILE_BEGIN(sample);
+	new_mem = mmap(NULL, size + get_block_meta_size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	PROFILE_END(PHASE_HEAP_GROWTH, sample);
+	DIE(new_mem == (void *) -1, "Mmap syscall failed!\n");
+
+	struct block_meta *new_block = new_mem;
+
+	new_block->size = size;
+	append_mapped_block(new_block);
 	return (char *)new_block + (int)get_block_meta_size();
 }
+
+/**
+ * @param block - mapped block
+ *	| Returns the start of the mapping holding the block. The header of
+ *	| a mapped block is at the start of the mapping, except for blocks
+ *	| alloced with a larger alignment, whose header is placed inside
+ *	| the first page so that the payload is aligned.
+ */
+static char *mapping_start(struct block_meta *block)
+{
+	uintptr_t page_size = getpagesize();
+
+	return (char *)((uintptr_t)block & ~(page_size - 1));
+}
+
+/**
+ * @param block - mapped block
+ *	| Returns the length of the mapping holding the block, from its
+ *	| start, which may be before the header, to the end of its last page.
+ */
+size_t mapping_length(struct block_meta *block)
+{
+	uintptr_t page_size = getpagesize();
+	uintptr_t end = ((uintptr_t)block + get_block_meta_size() + block->size + page_size - 1) & ~(page_size - 1);
+
+	return end - (uintptr_t)mapping_start(block);
+}
+
+/**
+ * @param block - mapped block that is unmapped
+ *	| Unmaps the whole mapping holding the block.
+ */
+void unmap_block(struct block_meta *block)
+{
+	int result = munmap(mapping_start(block), mapping_length(block));
+
+	DIE(result == -1, "Munmap failed!\n");
+}
+
+/**
+ * @param block - mapped block removed from the list
+ * @param limit - maximum number of bytes to unmap
+ *	| Unmaps whole pages from the end of the mapping, keeping the page
+ *	| of the header, and shrinks the block to the remaining pages.
+ *	| Returns the number of bytes unmapped.
+ */
+size_t trim_mapping(struct block_meta *block, size_t limit)
+{
+	uintptr_t page_size = getpagesize();
+	uintptr_t start = (uintptr_t)mapping_start(block);
+	uintptr_t end = start + mapping_length(block);
+	uintptr_t keep = ((uintptr_t)block + get_block_meta_size() + page_size - 1) & ~(page_size - 1);
+	uintptr_t first = end - (limit & ~(page_size - 1));
+
+	if (first < keep)
+		first = keep;
+	if (first >= end)
+		return 0;
+
+	int result = munmap((void *)first, end - first);
+
+	DIE(result == -1, "Munmap failed!\n");
+	block->size = first - (uintptr_t)block - get_block_meta_size();
+	return end - first;
+}
+
+/**
+ * @param size - aligned size of the new block
+ * @param alignment - alignment of the payload, a power of 2
+ *	| Maps a block whose payload is aligned to the given alignment.
+ *	| The header is placed right before the first aligned address
+ *	| after the start of the mapping (A). Whole pages in front of the
+ *	| header are unmapped, so the header stays in the first page. (B)
+ *	| The block keeps the rest of the mapping as its size. (C)
+ */
+static void *add_new_aligned_mapped_block(size_t size, size_t alignment)
+{
+	uintptr_t page_size = getpagesize();
+	size_t len = (size + alignment + get_block_meta_size() + page_size - 1) & ~(page_size - 1);
+
+	PROFILE_BEGIN(sample);
+	char *new_mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+
+	PROFILE_END(PHASE_HEAP_GROWTH, sample);
+	DIE(new_mem == (void *) -1, "Mmap syscall failed!\n");
+
+	// (A)
+	uintptr_t payload = ((uintptr_t)new_mem + get_block_meta_size() + alignment - 1) & ~(alignment - 1);
+	struct block_meta *new_block = (struct block_meta *)(payload - get_block_meta_size());
+
+	// (B)
+	char *start = mapping_start(new_block);
+
+	if (start != new_mem) {
+		int result = munmap(new_mem, start - new_mem);
+
+		DIE(result == -1, "Munmap failed!\n");
+	}
+
+	// (C)
+	new_block->size = new_mem + len - (char *)payload;
+	append_mapped_block(new_block);
+	return (void *)payload;
+}
+
+/**
+ * @param size - aligned size of the new block
+ * @param alignment - alignment of the payload, a power of 2 larger
+ *		  than ALIGNMENT
+ *	| Allocates a block whose payload is aligned to the given alignment.
+ *	| Large blocks are mapped (A). Otherwise a brk() block with room for
+ *	| the alignment and one more header is reused or added (B) and, if
+ *	| its payload isn't aligned, it is split so that the front part
+ *	| becomes a free block and the second one starts at an aligned
+ *	| payload (C). The tail is split off if possible. (D)
+ */
+void *add_new_aligned_block(size_t size, size_t alignment)
+{
+	size_t total_size = (size_t) align(size + alignment + get_block_meta_size());
+
+	// (A)
+	if (total_size + 2 * get_block_meta_size() >= MMAP_THRESHOLD)
+		return add_new_aligned_mapped_block(size, alignment);
+
+	// (B)
+	struct block_meta *block = find_best_fit(total_size);
+
+	if (block == NULL)
+		block = (struct block_meta *)((char *)add_new_alloced_block(total_size) - get_block_meta_size());
+
+	// (C)
+	uintptr_t payload = (uintptr_t)block + get_block_meta_size();
+
+	if ((payload & (alignment - 1)) != 0) {
+		uintptr_t aligned = (payload + get_block_meta_size() + alignment - 1) & ~(alignment - 1);
+
+		split_block(block, aligned - payload - get_block_meta_size());
+		block->status = STATUS_FREE;
+		meta_table_sync(block);
+		stamp_free_block(block);
+		block = block->next;
+		block->status = STATUS_ALLOC;
+		meta_table_sync(block);
+	}
+
+	// (D)
+	if (block->size > size + get_block_meta_size())
+		split_block(block, size);
+	return (char *)block + get_block_meta_size();
+}
 /**
  * @param block - block of memory realoced
  * @param size - aligned size of the realoced block
- *	| It first coalesces free blocks into contiguous free blocks
- *	| of memory and searches for a large enough free block where
- *	| to replace the block. It implements the best fit strategy, searches
- *	| for the smallest larger block of free memory. (A)
+ *	| It coalesces free blocks into contiguous free blocks of
+ *	| memory while searching for a large enough free block where
+ *	| to replace the block. It uses the current fit policy, by default
+ *	| best fit, which searches for the smallest larger block of free
+ *	| memory. (A)
  *	| After this, it tries to split the block if possible. (B)
  */
 void *find_free_block_realloc(struct block_meta *block, size_t total_size)
 {
-	coalesce();
-	struct block_meta *minim = (struct block_meta *)NULL;
-	int found = -1;
-	struct block_meta *ptr = NULL;
-
 	// (A)
-	for (ptr = heap_head; ptr != NULL; ptr = ptr->next) {
-		if (ptr->status == STATUS_FREE && ptr->size >= total_size) {
-			if (found == -1) {
-				minim = ptr;
-			} else {
-				if (minim->size > ptr->size)
-					minim = ptr;
-			}
-			found = 1;
-		}
-	}
+	struct block_meta *minim = fit_search(total_size);
+
 	/* (B) */
-	if (found == 1) {
+	if (minim != NULL) {
 		if (minim->size > get_block_meta_size() + total_size)
 			split_block(minim, total_size);
 		else
 			minim->status = STATUS_ALLOC;
 
+		minim->grow_count = block->grow_count;
 		block->status = STATUS_FREE;
+		meta_table_sync(minim);
+		meta_table_sync(block);
+		PROFILE_BEGIN(sample);
 		memmove((char *)minim + get_block_meta_size(), (char *)block + get_block_meta_size(), block->size);
+		PROFILE_END(PHASE_REALLOC_COPY, sample);
+		stamp_free_block(block);
 	}
 	return (void *)minim;
 }
@@ -102,11 +533,7 @@ void *find_free_block_realloc(struct block_meta *block, size_t total_size)
  */
 struct block_meta *find_last(void)
 {
-	struct block_meta *ptr = heap_head;
-
-	while (ptr->next != NULL && ptr->next->status != STATUS_MAPPED)
-		ptr = ptr->next;
-	return ptr;
+	return heap_last;
 }
 
 /**
@@ -120,37 +547,40 @@ struct block_meta *find_last(void)
 void *move_block_realloc(struct block_meta *block, size_t size)
 {
 	block->status = STATUS_FREE;
+	meta_table_sync(block);
 	if (size + get_block_meta_size() < MMAP_THRESHOLD) {
-		struct block_meta *last_alloced_block = heap_head;
-
-		while (1) {
-			struct block_meta *next_alloced_block = last_alloced_block->next;
-
-			if (next_alloced_block == NULL)
-				break;
-			if (next_alloced_block->status == STATUS_MAPPED)
-				break;
-			last_alloced_block = last_alloced_block->next;
-		}
+		struct block_meta *last_alloced_block = heap_last;
 		struct block_meta *new_block = (struct block_meta *)((char *)last_alloced_block
 				+ last_alloced_block->size + get_block_meta_size());
 		void *new_addr = (char *)new_block + size + get_block_meta_size();
 
+		PROFILE_BEGIN(sample);
 		int res = brk(new_addr);
+		PROFILE_END(PHASE_HEAP_GROWTH, sample);
 
 		DIE(res == -1, "Brk syscall failed!\n");
 		new_block->next = last_alloced_block->next;
 		last_alloced_block->next = new_block;
 		new_block->status = STATUS_ALLOC;
 		new_block->size = size;
+		new_block->grow_count = block->grow_count;
+		heap_last = new_block;
+		meta_table_sync(new_block);
 
+		PROFILE_BEGIN(copy_sample);
 		memcpy((char *)new_block + get_block_meta_size(), (char *)block + get_block_meta_size(), block->size);
+		PROFILE_END(PHASE_REALLOC_COPY, copy_sample);
+		stamp_free_block(block);
 
 		return (char *)new_block + get_block_meta_size();
 	}
 	void *new = add_new_mapped_block(size);
 
+	((struct block_meta *)((char *)new - get_block_meta_size()))->grow_count = block->grow_count;
+	PROFILE_BEGIN(sample);
 	memcpy(new, (char *)block + get_block_meta_size(), block->size);
+	PROFILE_END(PHASE_REALLOC_COPY, sample);
+	stamp_free_block(block);
 	return new;
 }
 /**
@@ -162,12 +592,15 @@ void *expand_last_block_realloc(struct block_meta *block, size_t size)
 {
 	void *new_mem = (char *)block + size + get_block_meta_size();
 
+	PROFILE_BEGIN(sample);
 	int res = brk(new_mem);
+	PROFILE_END(PHASE_HEAP_GROWTH, sample);
 
 	DIE(res == -1, "Brk syscall failed!\n");
 
 	block->status = STATUS_ALLOC;
 	block->size = size;
+	meta_table_sync(block);
 	return (char *)block + get_block_meta_size();
 }
 
@@ -179,10 +612,8 @@ void *expand_last_block_realloc(struct block_meta *block, size_t size)
  */
 void *expand_block_realloc(struct block_meta *block, size_t size)
 {
-	struct block_meta *next_block = block->next;
 	// (A)
-	block->size += next_block->size + get_block_meta_size();
-	block->next = next_block->next;
+	merge_next(block);
 
 	// (B)
 	if (block->size > size + get_block_meta_size())
@@ -199,11 +630,14 @@ void *expand_last_free(struct block_meta *block, size_t size)
 {
 	void *adr = (char *)block + size + get_block_meta_size();
 
+	PROFILE_BEGIN(sample);
 	int res = brk(adr);
+	PROFILE_END(PHASE_HEAP_GROWTH, sample);
 
 	DIE(res == -1, "Brk syscall failed!\n");
 	block->size = size;
 	block->status = STATUS_ALLOC;
+	meta_table_sync(block);
 	return (char *)block + get_block_meta_size();
 }
 /**
@@ -215,24 +649,14 @@ void *expand_last_free(struct block_meta *block, size_t size)
  */
 void coalesce_realloc(struct block_meta *block, size_t size)
 {
-	if (block == NULL)
+	if (block == NULL || block == brk_end())
 		return;
-	struct block_meta *block_current = block;
-	struct block_meta *block_next = block->next;
-
-	if (block_current->status == STATUS_FREE) {
-		size_t total_size = block_current->size;
-
-		if (block_next != NULL) {
-			while (block_next->status == STATUS_FREE) {
-				total_size += block_next->size + get_block_meta_size();
-				block_next = block_next->next;
-				block_current->next = block_next;
-				if (block_next == NULL || total_size >= size)
-					break;
-			}
-		}
-		block_current->size = total_size;
+
+	if (block->status == STATUS_FREE) {
+		PROFILE_BEGIN(sample);
+		while (block->size < size && block->next != brk_end() && block->next->status == STATUS_FREE)
+			merge_next(block);
+		PROFILE_END(PHASE_COALESCE, sample);
 	}
 }
 
@@ -246,10 +670,8 @@ void *try_realloc_expanding(struct block_meta *block, size_t size)
 {
 	coalesce_realloc(block->next, size - block->size - get_block_meta_size());
 	struct block_meta *next_block = block->next;
-	struct block_meta *last_block = heap_head;
+	struct block_meta *last_block = heap_last;
 
-	while (last_block->next != NULL && last_block->next->status != STATUS_MAPPED)
-		last_block = last_block->next;
 	// (A)
 	if (next_block != NULL && block->size + next_block->size + get_block_meta_size() >= size
 		&& next_block->status == STATUS_FREE)
@@ -260,38 +682,66 @@ void *try_realloc_expanding(struct block_meta *block, size_t size)
 	return NULL;
 }
 /**
- *	| This method iterates through the list and merges
- *	| free blocks of adjacent chunks of memory into a contiguous
- *	| block.
+ * @param block - block that will be realloced
+ * @param prev - block placed before it
+ * @param size - new aligned size of the block
+ *	| This method uses the free block placed before the given one (A),
+ *	| which find_block() recorded, so the list isn't walked again.
+ *	| If it is free and, together with the block and the free block
+ *	| following it, large enough for the new size (B), the blocks are
+ *	| merged into the previous one and the content is moved with one
+ *	| overlapping memmove() (C). The result is split if possible, keeping
+ *	| the growth headroom of repeatedly grown blocks when it fits. (D)
+ *	| Returns NULL if the previous block can't be used.
  */
-void coalesce(void)
+void *expand_block_backward(struct block_meta *block, struct block_meta *prev, size_t size)
 {
-	if (heap_head == NULL)
-		return;
+	// (A)
+	if (prev == NULL || prev->status != STATUS_FREE)
+		return NULL;
 
-	struct block_meta *block_current = heap_head;
-	struct block_meta *block_next = heap_head->next;
-
-	while (block_next != NULL) {
-		if (block_current->status == STATUS_FREE) {
-			size_t total_size = block_current->size;
-
-			while (block_next->status == STATUS_FREE) {
-				total_size += block_next->size + get_block_meta_size();
-				block_next = block_next->next;
-				block_current->next = block_next;
-				if (block_next == NULL)
-					break;
-			}
-			block_current->size = total_size;
-			block_current = block_next;
-			if (block_next != NULL)
-				block_next = block_next->next;
-		} else {
-			block_current = block_current->next;
-			block_next = block_next->next;
-		}
-	}
+	// (B)
+	struct block_meta *next_block = block->next;
+	size_t available = prev->size + block->size + get_block_meta_size();
+	int merge_next_block = next_block != brk_end() && next_block->status == STATUS_FREE;
+
+	if (merge_next_block)
+		available += next_block->size + get_block_meta_size();
+	if (available < size)
+		return NULL;
+
+	// (C)
+	size_t old_size = block->size;
+	int grow_count = block->grow_count;
+
+	merge_next(prev);
+	if (merge_next_block)
+		merge_next(prev);
+	prev->status = STATUS_ALLOC;
+	prev->grow_count = grow_count;
+	meta_table_sync(prev);
+	PROFILE_BEGIN(sample);
+	memmove((char *)prev + get_block_meta_size(), (char *)block + get_block_meta_size(), old_size);
+	PROFILE_END(PHASE_REALLOC_COPY, sample);
+
+	// (D)
+	size_t reserved_size = realloc_growth_size(prev, size);
+
+	if (reserved_size > prev->size)
+		reserved_size = size;
+	if (prev->size > reserved_size + get_block_meta_size())
+		split_block(prev, reserved_size);
+	return (char *)prev + get_block_meta_size();
+}
+/**
+ *	| This method iterates through the brk() part of the list and
+ *	| merges free blocks of adjacent chunks of memory into a contiguous
+ *	| block. The merges are timed by merge_free_run().
+ */
+void coalesce(void)
+{
+	for (struct block_meta *ptr = next_free_block(NULL); ptr != NULL; ptr = next_free_block(ptr))
+		merge_free_run(ptr, NULL);
 }
 /**
  * @param block - the block of memory that will be removed
@@ -300,19 +750,26 @@ void coalesce(void)
  */
 void delete_node(struct block_meta *block)
 {
-	struct block_meta *ptr = heap_head;
-	int result;
+	unlink_node(block);
+	unmap_block(block);
+}
 
+/**
+ * @param block - mapped block that will be removed
+ *	| This method removes a mapped block from the list without
+ *	| unmapping it. Mapped blocks are placed after the brk() ones,
+ *	| so the search for the previous node starts from heap_last.
+ */
+void unlink_node(struct block_meta *block)
+{
 	if (heap_head == block) {
 		heap_head = heap_head->next;
-		result = munmap(block, ptr->size + get_block_meta_size());
-		DIE(result == -1, "Munmap failed!\n");
 	} else {
+		struct block_meta *ptr = heap_last != NULL ? heap_last : heap_head;
+
 		while (ptr->next != block)
 			ptr = ptr->next;
 		ptr->next = ptr->next->next;
-		result = munmap(block, block->size + get_block_meta_size());
-		DIE(result == -1, "Munmap failed!\n");
 	}
 }
 
@@ -326,46 +783,42 @@ void delete_node(struct block_meta *block)
  */
 void split_block(struct block_meta *block, size_t size)
 {
+	PROFILE_BEGIN(sample);
 	struct block_meta *new_block = (struct block_meta *)((char *)block + size + get_block_meta_size());
 
 	new_block->size = block->size - size - get_block_meta_size();
 	new_block->next = block->next;
 	new_block->status = STATUS_FREE;
+	new_block->grow_count = 0;
 	block->next = new_block;
 	block->size = size;
 	block->status = STATUS_ALLOC;
+	if (block == heap_last)
+		heap_last = new_block;
+	meta_table_sync(block);
+	meta_table_sync(new_block);
+	stamp_free_block(new_block);
+	PROFILE_END(PHASE_SPLIT, sample);
 }
 
 /**
  * @size - the size of the contiguous free chunk of memory
- *	| This method first coalesces adjacent free blocks, then
- *	| searches using best-fit ideology the smallest larger
- *	| freed block and then tries to split it if possible.
+ *	| This method coalesces adjacent free blocks while searching
+ *	| a freed block using the current fit policy (by default the
+ *	| best-fit ideology, the smallest larger freed block) and then
+ *	| tries to split it if possible.
  */
 void *find_best_fit(size_t size)
 {
-	coalesce();
-	if (heap_head == NULL)
-		return NULL;
-
-	struct block_meta *best_fit = NULL;
-	struct block_meta *ptr = NULL;
+	struct block_meta *best_fit = fit_search(size);
 
-	for (ptr = heap_head; ptr != NULL; ptr = ptr->next) {
-		if (ptr->status == STATUS_FREE && ptr->size >= size) {
-			if (best_fit != NULL) {
-				if (best_fit->size > ptr->size)
-					best_fit = ptr;
-			} else {
-				best_fit = ptr;
-			}
-		}
-	}
 	if (best_fit != NULL) {
 		if ((int) (best_fit->size - size) > (int)get_block_meta_size())
 			split_block(best_fit, size);
 		else
 			best_fit->status = STATUS_ALLOC;
+		best_fit->grow_count = 0;
+		meta_table_sync(best_fit);
 	}
 
 	return best_fit;
@@ -381,51 +834,55 @@ void *find_best_fit(size_t size)
 void *add_new_alloced_block(size_t size)
 {
 	void *new_mem = NULL;
-	struct block_meta *last_alloced_block = heap_head;
+	struct block_meta *last_alloced_block = heap_last;
 	struct block_meta *new_block;
 
 	if (initialised != 0) {
-		while (1) {
-			struct block_meta *next_alloced_block = last_alloced_block->next;
-
-			if (next_alloced_block == NULL)
-				break;
-			if (next_alloced_block->status == STATUS_MAPPED)
-				break;
-			last_alloced_block = last_alloced_block->next;
-		}
-		if (last_alloced_block->status == STATUS_FREE) {
-			last_alloced_block->status = STATUS_ALLOC;
-			size_t remaining_size = align(size - last_alloced_block->size);
-
-			new_mem = (char *)last_alloced_block + last_alloced_block->size + get_block_meta_size() + remaining_size;
-			int res = brk(new_mem);
-
-			DIE(res == -1, "Brk syscall failed!\n");
-			last_alloced_block->size = size;
-			return (char *)last_alloced_block + get_block_meta_size();
-		}
-		if (last_alloced_block->status == STATUS_MAPPED) {
+		if (last_alloced_block == NULL) {
 			struct block_meta *new;
+
+			PROFILE_BEGIN(sample);
 			void *start = sbrk(0);
 
 			DIE(start == (void *)-1, "Sbrk failed!\n");
 
 			void *res = sbrk(MMAP_THRESHOLD);
 
+			PROFILE_END(PHASE_HEAP_GROWTH, sample);
 			DIE(res == (void *)-1, "Sbrk syscall failed!\n");
 
 			new = (struct block_meta *)start;
-			DIE(new == (void *) -1, "Sbrk syscall failed!");
-
-			new->size = size;
-			new->next = last_alloced_block;
-			new->status = MMAP_THRESHOLD;
+			new->size = MMAP_THRESHOLD - get_block_meta_size();
+			new->next = heap_head;
+			new->status = STATUS_ALLOC;
+			new->grow_count = 0;
 			heap_head = new;
+			heap_last = new;
+			meta_table_sync(new);
+
+			if (size + 2 * get_block_meta_size() < MMAP_THRESHOLD)
+				split_block(new, size);
 			return (char *)start + get_block_meta_size();
 		}
+		if (last_alloced_block->status == STATUS_FREE) {
+			last_alloced_block->status = STATUS_ALLOC;
+			last_alloced_block->grow_count = 0;
+			size_t remaining_size = align(size - last_alloced_block->size);
+
+			new_mem = (char *)last_alloced_block + last_alloced_block->size + get_block_meta_size() + remaining_size;
+			PROFILE_BEGIN(sample);
+			int res = brk(new_mem);
+			PROFILE_END(PHASE_HEAP_GROWTH, sample);
+
+			DIE(res == -1, "Brk syscall failed!\n");
+			last_alloced_block->size = size;
+			meta_table_sync(last_alloced_block);
+			return (char *)last_alloced_block + get_block_meta_size();
+		}
 		new_mem = (char *)last_alloced_block + last_alloced_block->size + size + 2 * get_block_meta_size();
+		PROFILE_BEGIN(sample);
 		int res = brk(new_mem);
+		PROFILE_END(PHASE_HEAP_GROWTH, sample);
 
 		DIE(res == -1, "Brk syscall() failed!\n");
 		new_block =  (struct block_meta *) ((char *)last_alloced_block
@@ -433,11 +890,15 @@ void *add_new_alloced_block(size_t size)
 		new_block->size = size;
 		new_block->next = last_alloced_block->next;
 		new_block->status = STATUS_ALLOC;
+		new_block->grow_count = 0;
 		last_alloced_block->next = new_block;
+		heap_last = new_block;
+		meta_table_sync(new_block);
 		return (char *)new_block + get_block_meta_size();
 	}
 	initialised = 1;
 
+	PROFILE_BEGIN(sample);
 	void *start = sbrk(0);
 
 	DIE(start == (void *)-1, "Sbrk syscall failed!\n");
@@ -446,11 +907,15 @@ void *add_new_alloced_block(size_t size)
 
 	void *res = sbrk(MMAP_THRESHOLD);
 
+	PROFILE_END(PHASE_HEAP_GROWTH, sample);
 	DIE(res == (void *)-1, "Sbrk syscall failed!\n");
 
 	heap_head->size = MMAP_THRESHOLD - get_block_meta_size();
 	heap_head->next = NULL;
 	heap_head->status = STATUS_ALLOC;
+	heap_head->grow_count = 0;
+	heap_last = heap_head;
+	meta_table_sync(heap_head);
 
 	if (size + 2 * get_block_meta_size() < MMAP_THRESHOLD)
 		split_block(heap_head, size);
@@ -485,16 +950,101 @@ void *add_new_block(size_t size)
 	else
 		return add_new_alloced_block(size);
 }
+/**
+ * @param block - block that is grown by realloc()
+ * @param size - new aligned size of the block
+ *	| Returns the size that should be reserved for a block that is
+ *	| grown. Blocks grown at least REALLOC_GROWTH_THRESHOLD times
+ *	| receive half of the requested size as headroom (A), so the
+ *	| following realloc() calls are served in place. The headroom is
+ *	| dropped if it would push the block over MMAP_THRESHOLD. (B)
+ */
+size_t realloc_growth_size(struct block_meta *block, size_t size)
+{
+	// (A)
+	if (block->grow_count < REALLOC_GROWTH_THRESHOLD)
+		return size;
+
+	size_t grown_size = (size_t) align(size + size / 2);
+
+	// (B)
+	if (grown_size + get_block_meta_size() >= MMAP_THRESHOLD)
+		return size;
+	return grown_size;
+}
+
+/**
+ * @param block - mapped block that is realloced
+ * @param size - new aligned size of the block
+ *	| Resizes a mapped block with mremap() instead of copying it into
+ *	| a new mapping. The block keeps the whole page rounded length as
+ *	| its size (A) and, since the mapping may move, the previous node
+ *	| in the list is updated to point to the new address. (B)
+ */
+void *remap_block_realloc(struct block_meta *block, size_t size)
+{
+	size_t page_size = getpagesize();
+	char *start = mapping_start(block);
+	size_t offset = (char *)block - start;
+	size_t old_len = offset + block->size + get_block_meta_size();
+	// (A)
+	size_t new_len = (offset + size + get_block_meta_size() + page_size - 1) / page_size * page_size;
+	PROFILE_BEGIN(sample);
+	char *new_start = mremap(start, old_len, new_len, MREMAP_MAYMOVE);
+
+	PROFILE_END(PHASE_HEAP_GROWTH, sample);
+	DIE(new_start == MAP_FAILED, "Mremap syscall failed!\n");
+
+	struct block_meta *new_block = (struct block_meta *)(new_start + offset);
+
+	new_block->size = new_len - offset - get_block_meta_size();
+
+	// (B)
+	if (new_block != block) {
+		if (heap_head == block) {
+			heap_head = new_block;
+		} else {
+			struct block_meta *ptr = heap_last != NULL ? heap_last : heap_head;
+
+			while (ptr->next != block)
+				ptr = ptr->next;
+			ptr->next = new_block;
+		}
+	}
+	return (char *)new_block + get_block_meta_size();
+}
+
 /**
  * @param adr - starting address of the block
+ * @param prev - set to the previous block, if not NULL
  *	| This method iterates through the list and returns
  *	| the block starting there or NULL in case it doesn't exist.
+ *	| With side tables, addresses inside the brk() heap are searched
+ *	| in the tables with a binary search (A) and other ones only in
+ *	| the mapped part. (B)
  */
-void *find_block(void *adr)
+void *find_block(void *adr, struct block_meta **prev)
 {
-	for (struct block_meta *ptr = heap_head; ptr != NULL; ptr = ptr->next) {
-		if (ptr == adr)
-			return (void *)ptr;
+	struct block_meta *ptr = heap_head;
+	struct block_meta *prev_block = NULL;
+
+	PROFILE_BEGIN(sample);
+	if (meta_table_enabled && heap_last != NULL && adr >= (void *)heap_head && adr <= (void *)heap_last) {
+		// (A)
+		ptr = meta_table_find(adr, &prev_block);
+	} else {
+		// (B)
+		if (meta_table_enabled) {
+			prev_block = heap_last;
+			ptr = brk_end();
+		}
+		for (; ptr != NULL; prev_block = ptr, ptr = ptr->next) {
+			if (ptr == adr)
+				break;
+		}
 	}
-	return NULL;
+	PROFILE_END(PHASE_FIND_BLOCK, sample);
+	if (prev != NULL)
+		*prev = prev_block;
+	return (void *)ptr;
 }
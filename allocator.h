@@ -25,18 +25,44 @@ void *add_new_block_calloc(size_t size);
 /*
     @param size - aligned size of the new memory block
 
+    | Method that adds a new block of memory at the end of the brk()
+    | alloced blocks, extending the heap.
+*/
+void *add_new_alloced_block(size_t size);
+/*
+    @param size - aligned size of the new memory block
+    @param alignment - alignment of the payload, a power of 2 larger
+                       than ALIGNMENT
+
+    | Method called by os_aligned_alloc(), adds a block whose payload
+    | is aligned to the given alignment, either in the brk() heap or
+    | in a new mapping for large blocks.
+*/
+void *add_new_aligned_block(size_t size, size_t alignment);
+/*
+    @param size - aligned size of the new memory block
+
     | This method is used to implement block reuse in the memory allocator.
     | Given a size, it finds the best fit in the linked list. The best fit
     | reffers to the smallest block larger than the required size.
 */
 void *find_best_fit(size_t size);
+/*
+    @param policy - one of the OS_FIT_* values
+
+    | Sets the policy used by find_best_fit() and find_free_block_realloc()
+    | when searching a free block: best fit, first fit, next fit or good fit.
+*/
+void set_fit_policy(int policy);
 /*
     @param adr - starting address of a block
+    @param prev - set to the block placed before the found one, or to
+                  NULL if it is the first one, unless it is NULL
 
     | Method used to iterate in the list and find the corresponding
     | block at the given address.
 */
-void *find_block(void *adr);
+void *find_block(void *adr, struct block_meta **prev);
 /*
     | Method used for merging adjacent free blocks in the linked list into
     | a contiguous chunk of free memory, used for preventing fragmentations.
@@ -58,6 +84,38 @@ void coalesce_realloc(struct block_meta *block, size_t size);
     | method is called on a mapped memory allocation.
 */
 void delete_node(struct block_meta *block);
+/*
+    @param block - mapped block that will be removed
+
+    | This method removes a mapped block from the linked list without
+    | unmapping it, used when the munmap() call is deferred.
+*/
+void unlink_node(struct block_meta *block);
+/*
+    @param block - mapped block
+
+    | This method unmaps the whole mapping holding the block.
+*/
+void unmap_block(struct block_meta *block);
+/*
+    @param block - mapped block
+
+    | This method returns the length of the mapping holding the block.
+*/
+size_t mapping_length(struct block_meta *block);
+/*
+    @param block - mapped block removed from the list
+    @param limit - maximum number of bytes to unmap
+
+    | This method unmaps at most limit bytes of whole pages from the end
+    | of the mapping holding the block and returns how many it unmapped.
+*/
+size_t trim_mapping(struct block_meta *block, size_t limit);
+/*
+    | This method returns the first block after the brk() part of the
+    | list, the end of a walk through the brk() blocks.
+*/
+struct block_meta *brk_end(void);
 /*
     @param block - block that will be split
     @param size - aligned size of the new memory block
@@ -87,6 +145,17 @@ void *try_realloc_expanding(struct block_meta *block, size_t size);
     | if possible.
 */
 void *expand_block_realloc(struct block_meta *block, size_t size);
+/*
+    @param block - the block that is realloced
+    @param prev - the block placed before it, as found by find_block()
+    @param size - new aligned size of the block
+
+    | This method merges the block with the free block placed before it
+    | (and the free block after it, if needed) and moves the content to
+    | the start of the merged block. Returns NULL if the previous block
+    | isn't free or the merged block is too small.
+*/
+void *expand_block_backward(struct block_meta *block, struct block_meta *prev, size_t size);
 /*
     @param block - the block that is realloced
     @param size - new aligned size of the block
@@ -123,3 +192,18 @@ void *find_free_block_realloc(struct block_meta *block, size_t total_size);
     | alloced block of memeory (using brk syscall)
 */
 struct block_meta *find_last(void);
+/*
+    @param block - block that is grown by realloc()
+    @param size - new aligned size of the block
+
+    | Function that returns the size to reserve for a block that is grown,
+    | adding geometric headroom to blocks that are repeatedly realloced.
+*/
+size_t realloc_growth_size(struct block_meta *block, size_t size);
+/*
+    @param block - mapped block that is realloced
+    @param size - new aligned size of the block
+
+    | Function that resizes a mapped block in place using mremap().
+*/
+void *remap_block_realloc(struct block_meta *block, size_t size);
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/**
+ * @name Dumitrescu Alexandra
+ * @date 10.04.2023
+ * @for  Operating Systems - Memory Allocator
+ *
+ * Churn benchmark of the fit policies: BENCH_LIVE blocks of random sizes
+ * are kept alive while BENCH_OPS random blocks are freed and alloced
+ * again. Prints the time per free + malloc pair and the heap growth.
+ * Sizes start above OS_SMALL_MAX, since smaller requests are served by
+ * the per-thread caches and never reach the fit search.
+ *
+ * Usage: bench_churn [best|first|next|good] [size range]
+ * (OSMEM_META_TABLE=1 in the environment enables the side tables)
+ */
+#include <stdint.h>
+#include <time.h>
+#include "osmem.h"
+#include "osmem_inline.h"
+#include "helpers.h"
+
+/**
+ * Number of live blocks and of free + malloc pairs
+ */
+#define BENCH_LIVE 2000
+#define BENCH_OPS  400000
+
+/**
+ * State of the xorshift generator, fixed so runs are comparable
+ */
+uint64_t bench_seed = 12345;
+
+/**
+ *	| Returns the next pseudo random number.
+ */
+static uint64_t bench_random(void)
+{
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return bench_seed;
+}
+
+/**
+ * @param max_size - width of the range of sizes
+ *	| Returns a random size in (OS_SMALL_MAX, OS_SMALL_MAX + max_size].
+ */
+static size_t bench_size(size_t max_size)
+{
+	return OS_SMALL_MAX + 1 + bench_random() % max_size;
+}
+
+/**
+ * @param name - name of a fit policy
+ *	| Returns the OS_FIT_* value of the policy, or -1.
+ */
+static int bench_policy(const char *name)
+{
+	if (strcmp(name, "best") == 0)
+		return OS_FIT_BEST;
+	if (strcmp(name, "first") == 0)
+		return OS_FIT_FIRST;
+	if (strcmp(name, "next") == 0)
+		return OS_FIT_NEXT;
+	if (strcmp(name, "good") == 0)
+		return OS_FIT_GOOD;
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	static void *blocks[BENCH_LIVE];
+	const char *name = argc > 1 ? argv[1] : "best";
+	size_t max_size = argc > 2 ? strtoul(argv[2], NULL, 10) : 1024;
+	int policy = bench_policy(name);
+	struct timespec start, end;
+
+	if (policy == -1 || max_size == 0) {
+		fprintf(stderr, "Usage: %s [best|first|next|good] [size range]\n", argv[0]);
+		return 1;
+	}
+	os_set_fit_policy(policy);
+
+	char *heap_start = sbrk(0);
+
+	for (int i = 0; i < BENCH_LIVE; i++)
+		blocks[i] = os_malloc(bench_size(max_size));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int op = 0; op < BENCH_OPS; op++) {
+		int i = bench_random() % BENCH_LIVE;
+
+		os_free(blocks[i]);
+		blocks[i] = os_malloc(bench_size(max_size));
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	long heap = ((char *)sbrk(0) - heap_start) / 1024;
+	double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+	printf("%-5s %10.1f ns/op  heap %ld KB\n", name, ns / BENCH_OPS, heap);
+	return 0;
+}
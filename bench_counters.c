@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/**
+ * @name Dumitrescu Alexandra
+ * @date 10.04.2023
+ * @for  Operating Systems - Memory Allocator
+ *
+ * Contended counters benchmark of OS_HINT_ISOLATED: every thread
+ * increments its own 8 byte counter BENCH_INCS times. Plain os_malloc()
+ * counters are packed next to each other, so the cores keep stealing the
+ * shared cache lines from each other, isolated ones get lines of their
+ * own. Prints the number of cache lines the counters use and the
+ * increments per second of each placement.
+ *
+ * Usage: bench_counters [threads]
+ * (the difference only shows when the threads run on separate cores)
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "osmem.h"
+#include "helpers.h"
+
+/**
+ * Largest number of threads and increments done by each thread
+ */
+#define BENCH_THREADS 64
+#define BENCH_INCS    50000000L
+
+/**
+ * Counter of each thread
+ */
+volatile long *bench_counters[BENCH_THREADS];
+
+/**
+ * @param arg - index of the counter of the thread
+ *	| Increments the counter BENCH_INCS times.
+ */
+static void *bench_thread(void *arg)
+{
+	volatile long *counter = bench_counters[(intptr_t)arg];
+
+	for (long i = 0; i < BENCH_INCS; i++)
+		(*counter)++;
+	return NULL;
+}
+
+/**
+ * @param threads - number of threads
+ *	| Returns the number of distinct 64 byte lines holding the counters.
+ */
+static int bench_lines(int threads)
+{
+	int lines = 0;
+
+	for (int i = 0; i < threads; i++) {
+		int shared = 0;
+
+		for (int j = 0; j < i; j++)
+			if ((uintptr_t)bench_counters[j] / 64 == (uintptr_t)bench_counters[i] / 64)
+				shared = 1;
+		lines += !shared;
+	}
+	return lines;
+}
+
+/**
+ * @param name - name of the placement
+ * @param threads - number of threads
+ * @param hint - hint the counters are alloced with
+ *	| Allocates the counters, runs the threads and prints the results.
+ */
+static void bench_run(const char *name, int threads, int hint)
+{
+	pthread_t tids[BENCH_THREADS];
+	struct timespec start, end;
+
+	for (int i = 0; i < threads; i++) {
+		bench_counters[i] = os_malloc_hint(sizeof(long), hint);
+		*bench_counters[i] = 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (intptr_t i = 0; i < threads; i++)
+		DIE(pthread_create(&tids[i], NULL, bench_thread, (void *)i) != 0, "pthread_create failed!\n");
+	for (int i = 0; i < threads; i++)
+		pthread_join(tids[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double sec = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%-8s %2d lines %10.1f Minc/s\n", name, bench_lines(threads),
+		   threads * BENCH_INCS / sec / 1e6);
+	for (int i = 0; i < threads; i++)
+		os_free((void *)bench_counters[i]);
+}
+
+int main(int argc, char **argv)
+{
+	int threads = argc > 1 ? atoi(argv[1]) : 4;
+
+	if (threads < 1 || threads > BENCH_THREADS) {
+		fprintf(stderr, "Usage: %s [threads, at most %d]\n", argv[0], BENCH_THREADS);
+		return 1;
+	}
+	bench_run("plain", threads, OS_HINT_NONE);
+	bench_run("isolated", threads, OS_HINT_ISOLATED);
+	return 0;
+}
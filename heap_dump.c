@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/**
+ * @name Dumitrescu Alexandra
+ * @date 10.04.2023
+ * @for  Operating Systems - Memory Allocator
+ */
+#define _GNU_SOURCE
+#include <unistd.h>
+#include "heap_dump.h"
+#include "alignment_utils.h"
+#include "helpers.h"
+#include "scavenger.h"
+#include "lifetime.h"
+
+extern struct block_meta *heap_head;
+extern struct short_segment *short_segments;
+
+/**
+ * Records added to the counted number when the temporary mapping is
+ * sized, for the blocks created while the lock isn't held
+ */
+#define HEAP_DUMP_SLACK 256
+
+/**
+ * Records of a snapshot, gathered in a temporary mapping
+ */
+struct dump_buffer {
+	struct heap_dump_record *records;
+	size_t count;
+	size_t capacity;
+};
+
+/**
+ * @param fd - file descriptor
+ * @param buf - buffer with len bytes
+ *	| Writes the whole buffer, retrying short writes.
+ */
+static int dump_write(int fd, const void *buf, size_t len)
+{
+	const char *ptr = buf;
+
+	while (len > 0) {
+		ssize_t res = write(fd, ptr, len);
+
+		if (res == -1 && errno == EINTR)
+			continue;
+		if (res <= 0)
+			return -1;
+		ptr += res;
+		len -= res;
+	}
+	return 0;
+}
+
+/**
+ * @param buffer - records gathered so far
+ * @param block - block that is recorded
+ * @param segment - segment of the block
+ *	| Stores the record if the buffer has room. The record is counted
+ *	| either way, so the caller knows how large the buffer must be.
+ */
+static void dump_record(struct dump_buffer *buffer, struct block_meta *block, uint32_t segment)
+{
+	if (buffer->count < buffer->capacity) {
+		struct heap_dump_record *record = &buffer->records[buffer->count];
+
+		record->address = (uintptr_t)block;
+		record->size = block->size;
+		record->status = block->status;
+		record->segment = segment;
+	}
+	buffer->count++;
+}
+
+/**
+ * @param buffer - buffer that receives the records
+ * @param header - header whose segment counts are set
+ *	| Walks the list, must be called with the list lock held. The
+ *	| blocks of the short-lived segments follow, each segment with its
+ *	| own number after the ones of the mapped blocks.
+ */
+static void dump_walk(struct dump_buffer *buffer, struct heap_dump_header *header)
+{
+	uint32_t segment = 0;
+
+	buffer->count = 0;
+	for (struct block_meta *ptr = heap_head; ptr != NULL; ptr = ptr->next) {
+		if (ptr->status == STATUS_MAPPED)
+			segment++;
+		dump_record(buffer, ptr, ptr->status == STATUS_MAPPED ? segment : 0);
+	}
+	header->mapped_segments = segment;
+
+	for (struct short_segment *seg = short_segments; seg != NULL; seg = seg->next) {
+		char *ptr = (char *)short_segment_blocks(seg);
+		char *end = ptr + seg->used;
+
+		segment++;
+		while (ptr < end) {
+			struct block_meta *block = (struct block_meta *)ptr;
+
+			dump_record(buffer, block, segment);
+			ptr += block->size + get_block_meta_size();
+		}
+	}
+	header->short_segments = segment - header->mapped_segments;
+}
+
+/**
+ * @param fd - file descriptor where the snapshot is written
+ *	| The records are counted by a first walk under the list lock (A).
+ *	| The temporary mapping is sized from that count while the lock
+ *	| isn't held, so no system call is made under it, and filled by a
+ *	| second walk. If blocks were added meanwhile and it is too small,
+ *	| it is mapped again with twice the new count, so a heap that keeps
+ *	| growing can't delay the dump for long (B). The header and the
+ *	| records are written after the lock is released, so other threads
+ *	| aren't stalled by the I/O and fd can be a pipe read by a thread
+ *	| of the same process. (C)
+ */
+int heap_dump(int fd)
+{
+	struct heap_dump_header header;
+	struct dump_buffer buffer = { NULL, 0, 0 };
+	int result = 0;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, HEAP_DUMP_MAGIC, sizeof(header.magic));
+	header.version = HEAP_DUMP_VERSION;
+	header.record_size = sizeof(struct heap_dump_record);
+	header.meta_size = get_block_meta_size();
+
+	// (A)
+	heap_lock();
+	dump_walk(&buffer, &header);
+	heap_unlock();
+
+	// (B)
+	while (buffer.count > buffer.capacity) {
+		size_t capacity = buffer.count + buffer.count / 8 + HEAP_DUMP_SLACK;
+
+		if (buffer.records != NULL) {
+			munmap(buffer.records, buffer.capacity * sizeof(struct heap_dump_record));
+			capacity = 2 * buffer.count;
+		}
+		buffer.capacity = capacity;
+		buffer.records = mmap(NULL, buffer.capacity * sizeof(struct heap_dump_record), PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANON, -1, 0);
+		if (buffer.records == MAP_FAILED)
+			return -1;
+
+		heap_lock();
+		dump_walk(&buffer, &header);
+		heap_unlock();
+	}
+
+	// (C)
+	result = dump_write(fd, &header, sizeof(header));
+	if (result == 0 && buffer.count > 0)
+		result = dump_write(fd, buffer.records, buffer.count * sizeof(struct heap_dump_record));
+	if (buffer.records != NULL)
+		munmap(buffer.records, buffer.capacity * sizeof(struct heap_dump_record));
+	return result;
+}
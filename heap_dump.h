@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+#include <stdint.h>
+/*
+    @name Dumitrescu Alexandra
+    @date 10.04.2023
+    @for  Operating Systems - Memory Allocator
+*/
+
+/*
+    Binary heap snapshot written by os_heap_dump(): one header followed
+    by one record for every block in the list, in list order, followed by
+    the blocks of the short-lived segments. Blocks alloced with brk()
+    belong to segment 0, every mapped block is its own segment, numbered
+    from 1 to mapped_segments, and the short-lived segments are numbered
+    after them. Version 2 added the segment counts to the header.
+*/
+#define HEAP_DUMP_MAGIC   "OSMEMDMP"
+#define HEAP_DUMP_VERSION 2
+
+struct heap_dump_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t meta_size;
+	uint32_t mapped_segments;
+	uint32_t short_segments;
+};
+
+struct heap_dump_record {
+	uint64_t address;
+	uint64_t size;
+	uint32_t status;
+	uint32_t segment;
+};
+
+/*
+    @param fd - file descriptor where the snapshot is written
+
+    | Writes the snapshot of the list without allocating memory from the
+    | heap: the records are counted under the list lock, gathered in a
+    | temporary mapping made while it isn't held and written once it is
+    | released. Returns 0, or -1 on write or mapping errors.
+*/
+int heap_dump(int fd);
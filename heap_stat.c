@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/**
+ * @name Dumitrescu Alexandra
+ * @date 10.04.2023
+ * @for  Operating Systems - Memory Allocator
+ *
+ * Offline tool that reads snapshots written by os_heap_dump() and prints
+ * fragmentation metrics and a histogram of the free blocks.
+ *
+ * Usage: heap_stat [snapshot] (reads stdin if no file is given)
+ */
+#include <stdint.h>
+#include "heap_dump.h"
+#include "helpers.h"
+
+/**
+ * Number of log2 buckets of the free space histogram
+ */
+#define HISTOGRAM_BUCKETS 48
+
+/**
+ * Metrics computed over the whole snapshot
+ */
+struct heap_stats {
+	uint64_t blocks;
+	uint64_t alloc_blocks;
+	uint64_t alloc_bytes;
+	uint64_t cached_blocks;
+	uint64_t cached_bytes;
+	uint64_t mapped_blocks;
+	uint64_t mapped_bytes;
+	uint64_t short_blocks;
+	uint64_t short_bytes;
+	uint64_t short_free_blocks;
+	uint64_t short_free_bytes;
+	uint64_t free_blocks;
+	uint64_t free_bytes;
+	uint64_t largest_free;
+	uint64_t brk_start;
+	uint64_t brk_end;
+	uint64_t free_histogram[HISTOGRAM_BUCKETS];
+	uint64_t free_bytes_histogram[HISTOGRAM_BUCKETS];
+};
+
+/**
+ * @param stats - metrics updated with the record
+ * @param header - header of the snapshot
+ * @param record - one block of the snapshot
+ *	| Adds one block to the metrics of its kind of segment. Blocks of the
+ *	| short-lived segments are counted apart, their freed blocks are
+ *	| only reused once the whole segment is empty (A). Mapped blocks
+ *	| have segments 1 to mapped_segments (B). The brk() heap bounds,
+ *	| its alloced bytes and the free blocks are taken from segment 0,
+ *	| blocks cached by the threads are neither alloced nor free. (C)
+ */
+static void add_record(struct heap_stats *stats, struct heap_dump_header *header, struct heap_dump_record *record)
+{
+	stats->blocks++;
+
+	// (A)
+	if (record->segment > header->mapped_segments) {
+		if (record->status == STATUS_FREE) {
+			stats->short_free_blocks++;
+			stats->short_free_bytes += record->size;
+		} else {
+			stats->short_blocks++;
+			stats->short_bytes += record->size;
+		}
+		return;
+	}
+
+	// (B)
+	if (record->segment != 0) {
+		stats->mapped_blocks++;
+		stats->mapped_bytes += record->size;
+		return;
+	}
+
+	// (C)
+	uint64_t end = record->address + header->meta_size + record->size;
+
+	if (stats->brk_start == 0 || record->address < stats->brk_start)
+		stats->brk_start = record->address;
+	if (end > stats->brk_end)
+		stats->brk_end = end;
+
+	if (record->status == STATUS_FREE) {
+		int bucket = 63 - __builtin_clzll(record->size | 1);
+
+		if (bucket >= HISTOGRAM_BUCKETS)
+			bucket = HISTOGRAM_BUCKETS - 1;
+		stats->free_blocks++;
+		stats->free_bytes += record->size;
+		stats->free_histogram[bucket]++;
+		stats->free_bytes_histogram[bucket] += record->size;
+		if (record->size > stats->largest_free)
+			stats->largest_free = record->size;
+	} else if (record->status == STATUS_CACHED) {
+		stats->cached_blocks++;
+		stats->cached_bytes += record->size;
+	} else {
+		stats->alloc_blocks++;
+		stats->alloc_bytes += record->size;
+	}
+}
+
+/**
+ * @param stats - metrics of the snapshot
+ * @param header - header of the snapshot
+ *	| Prints the metrics. External fragmentation is the share of free
+ *	| memory that isn't part of the largest free block.
+ */
+static void print_stats(struct heap_stats *stats, struct heap_dump_header *header)
+{
+	uint64_t brk_size = stats->brk_end - stats->brk_start;
+
+	printf("blocks:            %llu\n", (unsigned long long)stats->blocks);
+	printf("segments:          %llu brk heap, %u mappings, %u short-lived\n", stats->brk_end != 0 ? 1ULL : 0ULL,
+		   header->mapped_segments, header->short_segments);
+	printf("brk heap:          %llu bytes\n", (unsigned long long)brk_size);
+	printf("alloced:           %llu bytes in %llu blocks\n", (unsigned long long)stats->alloc_bytes,
+		   (unsigned long long)stats->alloc_blocks);
+	printf("cached:            %llu bytes in %llu blocks\n", (unsigned long long)stats->cached_bytes,
+		   (unsigned long long)stats->cached_blocks);
+	printf("mapped:            %llu bytes in %llu blocks\n", (unsigned long long)stats->mapped_bytes,
+		   (unsigned long long)stats->mapped_blocks);
+	printf("short-lived:       %llu bytes in %llu blocks, %llu freed bytes in %llu blocks\n",
+		   (unsigned long long)stats->short_bytes, (unsigned long long)stats->short_blocks,
+		   (unsigned long long)stats->short_free_bytes, (unsigned long long)stats->short_free_blocks);
+	printf("free:              %llu bytes in %llu blocks\n", (unsigned long long)stats->free_bytes,
+		   (unsigned long long)stats->free_blocks);
+	printf("largest free:      %llu bytes\n", (unsigned long long)stats->largest_free);
+	if (stats->free_bytes != 0)
+		printf("external frag:     %.2f%%\n",
+			   100.0 * (1.0 - (double)stats->largest_free / (double)stats->free_bytes));
+	if (brk_size != 0)
+		printf("brk heap use:      %.2f%%\n", 100.0 * (double)stats->alloc_bytes / (double)brk_size);
+
+	printf("free space histogram:\n");
+	for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+		if (stats->free_histogram[bucket] == 0)
+			continue;
+		printf("  [%llu, %llu): %llu blocks, %llu bytes\n", bucket == 0 ? 0ULL : 1ULL << bucket,
+			   1ULL << (bucket + 1), (unsigned long long)stats->free_histogram[bucket],
+			   (unsigned long long)stats->free_bytes_histogram[bucket]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *in = stdin;
+	struct heap_dump_header header;
+	struct heap_dump_record record;
+	struct heap_stats stats;
+
+	if (argc > 1) {
+		in = fopen(argv[1], "rb");
+		DIE(in == NULL, argv[1]);
+	}
+
+	if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, HEAP_DUMP_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != HEAP_DUMP_VERSION || header.record_size != sizeof(record)) {
+		fprintf(stderr, "Not a heap snapshot\n");
+		return 1;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	while (fread(&record, sizeof(record), 1, in) == 1)
+		add_record(&stats, &header, &record);
+
+	print_stats(&stats, &header);
+	if (in != stdin)
+		fclose(in);
+	return 0;
+}
@@ -24,6 +24,7 @@
 struct block_meta {
 	size_t size;
 	int status;
+	int grow_count;
 	struct block_meta *next;
 };
 
@@ -31,3 +32,6 @@ struct block_meta {
 #define STATUS_FREE   0
 #define STATUS_ALLOC  1
 #define STATUS_MAPPED 2
+#define STATUS_SHORT  3
+#define STATUS_CACHED 4
+#define STATUS_ISOLATED 5
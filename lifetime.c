@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/**
+ * @name Dumitrescu Alexandra
+ * @date 10.04.2023
+ * @for  Operating Systems - Memory Allocator
+ */
+#include <stdint.h>
+#include <unistd.h>
+#include "lifetime.h"
+#include "alignment_utils.h"
+#include "profile.h"
+
+/**
+ * List of the short-lived segments, the first one is the segment
+ * where new blocks are carved.
+ */
+struct short_segment *short_segments;
+/**
+ * Number of segments in the list that have no live blocks
+ */
+int empty_segments;
+/**
+ * Lowest start and highest end of the short-lived segments, so that
+ * free() and realloc() of other blocks don't walk the list.
+ */
+char *short_segments_low;
+char *short_segments_high;
+
+/**
+ *	| Recomputes the bounds of the segments after one is unmapped.
+ */
+static void update_segment_bounds(void)
+{
+	short_segments_low = NULL;
+	short_segments_high = NULL;
+	for (struct short_segment *segment = short_segments; segment != NULL; segment = segment->next) {
+		if (short_segments_low == NULL || (char *)segment < short_segments_low)
+			short_segments_low = (char *)segment;
+		if ((char *)segment + SHORT_SEGMENT_SIZE > short_segments_high)
+			short_segments_high = (char *)segment + SHORT_SEGMENT_SIZE;
+	}
+}
+
+struct block_meta *short_segment_blocks(struct short_segment *segment)
+{
+	return (struct block_meta *)((char *)segment + align(sizeof(struct short_segment)));
+}
+
+/**
+ * @param segment - short-lived segment
+ *	| Returns the number of bytes left for blocks in the segment.
+ */
+static size_t segment_room(struct short_segment *segment)
+{
+	return SHORT_SEGMENT_SIZE - align(sizeof(struct short_segment)) - segment->used;
+}
+
+/**
+ * @param size - aligned size of the new block
+ *	| Returns a segment with room for the block: the current one if the
+ *	| block fits (A), an empty segment that is reset (B) or a new
+ *	| mapping (C). The returned segment is moved to the front of the list.
+ */
+static struct short_segment *get_segment(size_t size)
+{
+	struct short_segment *segment = short_segments, *prev = NULL;
+
+	// (A)
+	if (segment != NULL && segment_room(segment) >= size + get_block_meta_size())
+		return segment;
+
+	// (B)
+	while (segment != NULL && segment->live != 0) {
+		prev = segment;
+		segment = segment->next;
+	}
+	if (segment != NULL) {
+		if (prev != NULL) {
+			prev->next = segment->next;
+			segment->next = short_segments;
+			short_segments = segment;
+		}
+		segment->used = 0;
+		empty_segments--;
+		return segment;
+	}
+
+	// (C)
+	PROFILE_BEGIN(sample);
+	segment = mmap(NULL, SHORT_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	PROFILE_END(PHASE_HEAP_GROWTH, sample);
+	DIE(segment == (void *) -1, "Mmap syscall failed!\n");
+
+	segment->used = 0;
+	segment->live = 0;
+	segment->next = short_segments;
+	short_segments = segment;
+	if (short_segments_low == NULL || (char *)segment < short_segments_low)
+		short_segments_low = (char *)segment;
+	if ((char *)segment + SHORT_SEGMENT_SIZE > short_segments_high)
+		short_segments_high = (char *)segment + SHORT_SEGMENT_SIZE;
+	return segment;
+}
+
+void *add_short_block(size_t size)
+{
+	struct short_segment *segment = get_segment(size);
+	struct block_meta *block = (struct block_meta *)((char *)short_segment_blocks(segment) + segment->used);
+
+	block->size = size;
+	block->status = STATUS_SHORT;
+	block->grow_count = 0;
+	block->next = NULL;
+	segment->used += size + get_block_meta_size();
+	segment->live++;
+	return (char *)block + get_block_meta_size();
+}
+
+/**
+ * @param size - size of the new block, rounded by isolated_size()
+ *	| Segments are page aligned, so the header is placed for the payload
+ *	| to start on a cache line. Room is asked for the block and two lines
+ *	| of padding (A). The gap before the header becomes a free block,
+ *	| one line longer if it can't hold a header (B). The block is then
+ *	| carved from the same segment, and as its size fills whole lines,
+ *	| the next block's data starts on the next line. (C)
+ */
+void *add_isolated_short_block(size_t size)
+{
+	// (A)
+	struct short_segment *segment = get_segment(size + 2 * CACHE_LINE_SIZE);
+	struct block_meta *pad = (struct block_meta *)((char *)short_segment_blocks(segment) + segment->used);
+	size_t gap = -((uintptr_t)pad + get_block_meta_size()) & (CACHE_LINE_SIZE - 1);
+
+	// (B)
+	if (gap != 0) {
+		if (gap < get_block_meta_size())
+			gap += CACHE_LINE_SIZE;
+		pad->size = gap - get_block_meta_size();
+		pad->status = STATUS_FREE;
+		pad->grow_count = 0;
+		pad->next = NULL;
+		segment->used += gap;
+	}
+
+	// (C)
+	return add_short_block(size);
+}
+
+/**
+ * @param ptr - address
+ *	| Returns the short-lived segment holding the address or NULL.
+ *	| Addresses outside the bounds of all segments, which include any
+ *	| address while there is no segment, are rejected first.
+ */
+static struct short_segment *find_segment(void *ptr)
+{
+	if ((char *)ptr <= short_segments_low || (char *)ptr >= short_segments_high)
+		return NULL;
+	for (struct short_segment *segment = short_segments; segment != NULL; segment = segment->next) {
+		if ((char *)ptr > (char *)segment && (char *)ptr < (char *)segment + SHORT_SEGMENT_SIZE)
+			return segment;
+	}
+	return NULL;
+}
+
+struct block_meta *find_short_block(void *ptr)
+{
+	if (find_segment(ptr) == NULL)
+		return NULL;
+	return (struct block_meta *)((char *)ptr - get_block_meta_size());
+}
+
+/**
+ * @param block - short-lived block
+ *	| Marks the block as free (A). If it was the last live block of its
+ *	| segment, the segment is reset if it is the current one (B), kept
+ *	| for reuse while there are at most SHORT_SEGMENT_CACHE empty ones
+ *	| (C), or unmapped otherwise. (D)
+ */
+void free_short_block(struct block_meta *block)
+{
+	struct short_segment *segment = find_segment(block);
+
+	// (A)
+	block->status = STATUS_FREE;
+	if (--segment->live != 0)
+		return;
+
+	// (B)
+	if (segment == short_segments) {
+		segment->used = 0;
+		return;
+	}
+
+	// (C)
+	if (empty_segments < SHORT_SEGMENT_CACHE) {
+		empty_segments++;
+		return;
+	}
+
+	// (D)
+	struct short_segment *prev = short_segments;
+
+	while (prev->next != segment)
+		prev = prev->next;
+	prev->next = segment->next;
+
+	int result = munmap(segment, SHORT_SEGMENT_SIZE);
+
+	DIE(result == -1, "Munmap failed!\n");
+	update_segment_bounds();
+}
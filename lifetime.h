@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+#include "helpers.h"
+/*
+    @name Dumitrescu Alexandra
+    @date 10.04.2023
+    @for  Operating Systems - Memory Allocator
+*/
+
+/*
+    Size of the mapped segments holding short-lived blocks, largest block
+    placed in them and number of empty segments kept mapped for reuse.
+*/
+#define SHORT_SEGMENT_SIZE  (256 * 1024)
+#define SHORT_BLOCK_MAX     (SHORT_SEGMENT_SIZE / 8)
+#define SHORT_SEGMENT_CACHE 2
+
+/*
+    Segment of short-lived blocks. Blocks are carved one after the other
+    starting right after the segment header, each one with its own
+    block_meta header with STATUS_SHORT, and they are not part of the
+    list. The segment is reset once all of its blocks are freed.
+*/
+struct short_segment {
+	struct short_segment *next;
+	size_t used;
+	size_t live;
+};
+
+/*
+    @param size - aligned size of the new memory block
+
+    | Method that carves a short-lived block out of the current segment,
+    | mapping a new segment if needed. Returns the payload.
+*/
+void *add_short_block(size_t size);
+/*
+    @param size - size of the new memory block, rounded by isolated_size()
+
+    | Method that carves a short-lived block whose payload starts on a
+    | cache line, so that it shares no line with another block's data.
+*/
+void *add_isolated_short_block(size_t size);
+/*
+    @param ptr - payload address
+
+    | Method that returns the short-lived block of the given payload,
+    | or NULL if the address isn't inside a short-lived segment.
+*/
+struct block_meta *find_short_block(void *ptr);
+/*
+    @param block - short-lived block
+
+    | Method that frees a short-lived block. When the last block of a
+    | segment is freed, the whole segment is reset for reuse or unmapped.
+*/
+void free_short_block(struct block_meta *block);
+/*
+    @param segment - short-lived segment
+
+    | Returns the address of the first block in the segment.
+*/
+struct block_meta *short_segment_blocks(struct short_segment *segment);
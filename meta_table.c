@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/**
+ * @name Dumitrescu Alexandra
+ * @date 10.04.2023
+ * @for  Operating Systems - Memory Allocator
+ */
+#define _GNU_SOURCE
+#include "meta_table.h"
+#include "alignment_utils.h"
+#include "allocator.h"
+
+extern struct block_meta *heap_head;
+extern struct block_meta *heap_last;
+
+/**
+ * Side tables of the brk() heap
+ */
+struct meta_table meta_table;
+/**
+ * Value set while the side tables are used by the heap walks
+ */
+int meta_table_enabled;
+/**
+ * Value set once OSMEM_META_TABLE was read or set_meta_table() called
+ */
+short int meta_table_checked;
+
+/**
+ * @param table - table that is resized, NULL if not mapped yet
+ * @param old_len - current length of the table
+ * @param len - new length of the table
+ *	| Maps a table the first time (A), later resizes it with mremap(),
+ *	| which may move it. (B)
+ */
+static void *meta_table_resize(void *table, size_t old_len, size_t len)
+{
+	void *new_table;
+
+	// (A)
+	if (table == NULL) {
+		new_table = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+		DIE(new_table == MAP_FAILED, "Mmap syscall failed!\n");
+	} else {
+		// (B)
+		new_table = mremap(table, old_len, len, MREMAP_MAYMOVE);
+		DIE(new_table == MAP_FAILED, "Mremap syscall failed!\n");
+	}
+	return new_table;
+}
+
+/**
+ *	| Doubles the number of entries of the tables.
+ */
+static void meta_table_grow(void)
+{
+	size_t capacity = meta_table.capacity != 0 ? 2 * meta_table.capacity : META_TABLE_INITIAL_ENTRIES;
+
+	meta_table.offset = meta_table_resize(meta_table.offset, meta_table.capacity * sizeof(uint32_t),
+			capacity * sizeof(uint32_t));
+	meta_table.size = meta_table_resize(meta_table.size, meta_table.capacity * sizeof(uint32_t),
+			capacity * sizeof(uint32_t));
+	meta_table.status = meta_table_resize(meta_table.status, meta_table.capacity, capacity);
+	meta_table.capacity = capacity;
+}
+
+/**
+ * @param offset - header offset in ALIGNMENT units
+ *	| Returns the index of the first entry whose offset is not smaller
+ *	| than the given one. The entry used last and the one after it are
+ *	| checked first (A), since walks and splits move forward through
+ *	| the heap, before the binary search. (B)
+ */
+static size_t meta_table_index(uint32_t offset)
+{
+	size_t cursor = meta_table.cursor;
+
+	// (A)
+	if (cursor < meta_table.count && meta_table.offset[cursor] <= offset) {
+		if (meta_table.offset[cursor] == offset)
+			return cursor;
+		if (cursor + 1 == meta_table.count || meta_table.offset[cursor + 1] >= offset)
+			return cursor + 1;
+	}
+
+	// (B)
+	size_t low = 0;
+	size_t high = meta_table.count;
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (meta_table.offset[mid] < offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/**
+ * @param block - brk() block
+ *	| Returns the offset of the header in ALIGNMENT units.
+ */
+static uint32_t block_offset(struct block_meta *block)
+{
+	return ((char *)block - meta_table.base) / ALIGNMENT;
+}
+
+/**
+ * @param block - block whose size or status changed
+ *	| Blocks outside [start of the heap, heap_last] are mapped or
+ *	| short-lived ones and are ignored (A). New brk() blocks become
+ *	| heap_last before they are synced, so no sbrk() call is needed.
+ *	| The start of the heap is the head of the list, since brk()
+ *	| blocks are placed first (B).
+ *	| The entry of the block is updated, or a new one is inserted in
+ *	| address order. (C)
+ */
+void meta_table_update(struct block_meta *block)
+{
+	// (B)
+	if (meta_table.base == NULL && heap_last != NULL)
+		meta_table.base = (char *)heap_head;
+
+	// (A)
+	if (meta_table.base == NULL || (char *)block < meta_table.base || block > heap_last)
+		return;
+	DIE(block->size / ALIGNMENT > UINT32_MAX || (char *)block - meta_table.base > (long)UINT32_MAX * ALIGNMENT,
+		"Heap too large for the side tables!\n");
+
+	// (C)
+	uint32_t offset = block_offset(block);
+	size_t index = meta_table_index(offset);
+
+	if (index == meta_table.count || meta_table.offset[index] != offset) {
+		size_t moved = meta_table.count - index;
+
+		if (meta_table.count == meta_table.capacity)
+			meta_table_grow();
+		memmove(meta_table.offset + index + 1, meta_table.offset + index, moved * sizeof(uint32_t));
+		memmove(meta_table.size + index + 1, meta_table.size + index, moved * sizeof(uint32_t));
+		memmove(meta_table.status + index + 1, meta_table.status + index, moved);
+		meta_table.offset[index] = offset;
+		meta_table.count++;
+	}
+	meta_table.size[index] = block->size / ALIGNMENT;
+	meta_table.status[index] = block->status;
+	meta_table.cursor = index;
+}
+
+/**
+ * @param block - brk() block absorbed by a merge
+ *	| Removes the entry of the block, if it has one.
+ */
+void meta_table_remove(struct block_meta *block)
+{
+	if (meta_table.base == NULL || (char *)block < meta_table.base)
+		return;
+
+	uint32_t offset = block_offset(block);
+	size_t index = meta_table_index(offset);
+
+	if (index == meta_table.count || meta_table.offset[index] != offset)
+		return;
+
+	size_t moved = meta_table.count - index - 1;
+
+	memmove(meta_table.offset + index, meta_table.offset + index + 1, moved * sizeof(uint32_t));
+	memmove(meta_table.size + index, meta_table.size + index + 1, moved * sizeof(uint32_t));
+	memmove(meta_table.status + index, meta_table.status + index + 1, moved);
+	meta_table.count--;
+	meta_table.cursor = index != 0 ? index - 1 : 0;
+}
+
+/**
+ * @param enable - whether the side tables are used
+ *	| Enabling fills the tables with one walk through the headers of
+ *	| the brk() blocks (A). Disabling unmaps them. (B)
+ */
+void set_meta_table(int enable)
+{
+	meta_table_checked = 1;
+	if (enable && !meta_table_enabled) {
+		// (A)
+		meta_table_enabled = 1;
+		for (struct block_meta *ptr = heap_head; ptr != brk_end(); ptr = ptr->next)
+			meta_table_update(ptr);
+	} else if (!enable && meta_table_enabled) {
+		// (B)
+		meta_table_enabled = 0;
+		if (meta_table.capacity != 0) {
+			munmap(meta_table.offset, meta_table.capacity * sizeof(uint32_t));
+			munmap(meta_table.size, meta_table.capacity * sizeof(uint32_t));
+			munmap(meta_table.status, meta_table.capacity);
+		}
+		memset(&meta_table, 0, sizeof(meta_table));
+	}
+}
+
+/**
+ *	| Reads OSMEM_META_TABLE the first time the heap is searched.
+ */
+void meta_table_check_env(void)
+{
+	if (meta_table_checked)
+		return;
+
+	char *value = getenv("OSMEM_META_TABLE");
+
+	set_meta_table(value != NULL && strcmp(value, "1") == 0);
+}
+
+/**
+ * @param adr - address of a header inside the brk() heap
+ * @param prev - set to the block placed before the found one
+ *	| Binary search of the address in the offsets, the previous block
+ *	| is given by the entry before the found one.
+ */
+struct block_meta *meta_table_find(void *adr, struct block_meta **prev)
+{
+	if (meta_table.base == NULL || (char *)adr < meta_table.base
+		|| ((char *)adr - meta_table.base) % ALIGNMENT != 0)
+		return NULL;
+
+	uint32_t offset = block_offset(adr);
+	size_t index = meta_table_index(offset);
+
+	if (index == meta_table.count || meta_table.offset[index] != offset)
+		return NULL;
+	meta_table.cursor = index;
+	*prev = NULL;
+	if (index != 0)
+		*prev = (struct block_meta *)(meta_table.base + (size_t)meta_table.offset[index - 1] * ALIGNMENT);
+	return (struct block_meta *)adr;
+}
+
+/**
+ * @param block - brk() block or NULL
+ *	| Finds the entry of the block and scans the status table after it
+ *	| with memchr().
+ */
+struct block_meta *meta_table_next_free(struct block_meta *block)
+{
+	size_t start = 0;
+
+	if (block != NULL)
+		start = meta_table_index(block_offset(block)) + 1;
+	if (start >= meta_table.count)
+		return NULL;
+
+	unsigned char *found = memchr(meta_table.status + start, STATUS_FREE, meta_table.count - start);
+
+	if (found == NULL)
+		return NULL;
+	meta_table.cursor = found - meta_table.status;
+	return (struct block_meta *)(meta_table.base + (size_t)meta_table.offset[meta_table.cursor] * ALIGNMENT);
+}
+
+/**
+ * @param block - brk() block
+ *	| Returns the size of the block from its entry.
+ */
+size_t meta_table_size(struct block_meta *block)
+{
+	return (size_t)meta_table.size[meta_table_index(block_offset(block))] * ALIGNMENT;
+}
+
+/**
+ * @param block - brk() block
+ *	| Returns whether the block following the given one is free.
+ */
+int meta_table_next_is_free(struct block_meta *block)
+{
+	size_t index = meta_table_index(block_offset(block)) + 1;
+
+	return index < meta_table.count && meta_table.status[index] == STATUS_FREE;
+}
@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+#include <stdint.h>
+#include "helpers.h"
+/*
+    @name Dumitrescu Alexandra
+    @date 10.04.2023
+    @for  Operating Systems - Memory Allocator
+*/
+
+/*
+    Number of entries of the side tables when they are first mapped,
+    they are doubled when needed.
+*/
+#define META_TABLE_INITIAL_ENTRIES 1024
+
+/*
+    Side tables of the brk() heap, with one entry per block in address
+    order: the offset of the header from the start of the heap and the
+    size (both in ALIGNMENT units) and the status of the block. Blocks
+    cached by a thread keep the status they had before in the tables. Walks
+    read these dense arrays instead of following the headers, and the
+    entry of a block is found by binary search on the offsets, starting
+    with the entry used last.
+*/
+struct meta_table {
+	char *base;
+	uint32_t *offset;
+	uint32_t *size;
+	unsigned char *status;
+	size_t count;
+	size_t capacity;
+	size_t cursor;
+};
+
+/*
+    Value set while the side tables are used by the heap walks
+*/
+extern int meta_table_enabled;
+
+/*
+    @param block - block whose size or status changed
+
+    | Copies the size and status of a brk() block into its entry, adding
+    | the entry for a new block. Blocks outside the brk() heap are ignored.
+*/
+void meta_table_update(struct block_meta *block);
+/*
+    @param block - brk() block absorbed by a merge
+
+    | Removes the entry of a block that no longer exists.
+*/
+void meta_table_remove(struct block_meta *block);
+/*
+    @param block - block whose size or status changed
+
+    | Called after every change of the size or status of a block, it
+    | only updates the side tables while they are enabled.
+*/
+static inline void meta_table_sync(struct block_meta *block)
+{
+	if (meta_table_enabled)
+		meta_table_update(block);
+}
+/*
+    @param block - block absorbed by a merge
+
+    | Called when a block is merged into the previous one.
+*/
+static inline void meta_table_erase(struct block_meta *block)
+{
+	if (meta_table_enabled)
+		meta_table_remove(block);
+}
+/*
+    @param enable - whether the side tables are used
+
+    | Enables the side tables, filling them from the headers of the
+    | current brk() blocks, or disables and unmaps them.
+*/
+void set_meta_table(int enable);
+/*
+    | Enables the side tables if OSMEM_META_TABLE=1 is set in the
+    | environment, unless set_meta_table() was called before.
+*/
+void meta_table_check_env(void);
+/*
+    @param adr - address of a header inside the brk() heap
+    @param prev - set to the block placed before the found one
+
+    | Returns the brk() block starting at the given address or NULL.
+*/
+struct block_meta *meta_table_find(void *adr, struct block_meta **prev);
+/*
+    @param block - brk() block or NULL
+
+    | Returns the first free brk() block after the given one, or from
+    | the start of the heap for NULL, reading only the status table.
+    | Returns NULL if there is none.
+*/
+struct block_meta *meta_table_next_free(struct block_meta *block);
+/*
+    @param block - brk() block
+
+    | Returns the size of the block read from the side tables.
+*/
+size_t meta_table_size(struct block_meta *block);
+/*
+    @param block - brk() block
+
+    | Returns whether the block following the given one is free, read
+    | from the side tables.
+*/
+int meta_table_next_is_free(struct block_meta *block);
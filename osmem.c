@@ -8,11 +8,18 @@
 #include "osmem.h"
 #include "alignment_utils.h"
 #include "allocator.h"
+#include "scavenger.h"
+#include "profile.h"
+#include "heap_dump.h"
+#include "lifetime.h"
+#include "tcache.h"
+#include "meta_table.h"
 #include "../utils/printf.h"
 
 /**
  * @param size - size of new payload
- *	| First align the memory, then check if there is a possible best
+ *	| Small requests take the inline fast path (A). Otherwise, first
+ *	| align the memory, then check if there is a possible best
  *	| fit for it. If there is, then return the address of the block's
  *	| payload, if not add the block to the list.
  */
@@ -20,37 +27,170 @@ void *os_malloc(size_t size)
 {
 	if (size == 0)
 		return NULL;
+
+	// (A)
+	if (size <= OS_SMALL_MAX)
+		return os_malloc_small(size);
+
 	size_t block_size = (size_t) align((size));
+	void *adr;
+
+	heap_lock();
 	struct block_meta *best_fit =  (struct block_meta *)find_best_fit(block_size);
 
 	if (best_fit == NULL)
-		return add_new_block(block_size);
+		adr = add_new_block(block_size);
+	else
+		adr = (void *)((char *)best_fit + get_block_meta_size());
+	heap_unlock();
 
-	return (void *)((char *)best_fit + get_block_meta_size());
+	return adr;
 }
 
 /**
  * @param adr - beginning address of a payload
  *	| First searches for the corresponding block in the list,
  *	| then splits into 2 cases: (A) if the block is alloced, then
- *	| just sets the status to free, (B) if the block is mapped
- *	| frees the memory and directly remove the node from list.
+ *	| caches it for the small allocation fast path if possible, or
+ *	| just sets the status to free, isolated blocks are kept apart
+ *	| for isolated requests, (B) if the block is mapped
+ *	| frees the memory and directly remove the node from list. While
+ *	| the scavenger runs, the freed block is stamped with the current
+ *	| pass and the munmap() of mapped blocks is left to the scavenger.
+ *	| Short-lived blocks are freed inside their segment. (C)
  */
 void os_free(void *ptr)
 {
 	if (ptr != NULL) {
-		struct block_meta *block = (struct block_meta *)find_block((char *)ptr - get_block_meta_size());
+		heap_lock();
+		struct block_meta *block = find_short_block(ptr);
+
+		// (C)
+		if (block != NULL) {
+			if (block->status == STATUS_SHORT)
+				free_short_block(block);
+			heap_unlock();
+			return;
+		}
+
+		block = (struct block_meta *)find_block((char *)ptr - get_block_meta_size(), NULL);
 
 		// (A)
-		if (block != NULL && block->status == STATUS_ALLOC) {
+		if (block != NULL && block->status == STATUS_ALLOC && !tcache_push(block)) {
 			block->status = STATUS_FREE;
+			meta_table_sync(block);
+			stamp_free_block(block);
 			ptr = NULL;
 		}
+		if (block != NULL && block->status == STATUS_ISOLATED)
+			free_isolated_block(block);
 
 		// (B)
-		if (block != NULL && block->status == STATUS_MAPPED)
+		if (block != NULL && block->status == STATUS_MAPPED && !defer_unmap(block))
 			delete_node(block);
+		heap_unlock();
+	}
+}
+
+/**
+ * @param size - size of new payload
+ * @param hint - expected lifetime of the block, one of OS_HINT_*
+ *	| Short-lived blocks that fit in a segment are carved from the
+ *	| short-lived segments (A), so they don't get interleaved with
+ *	| long-lived blocks in the brk() heap. Everything else goes
+ *	| through malloc(). (B) Blocks with the OS_HINT_ISOLATED flag are
+ *	| placed on cache lines of their own, in a short-lived segment if
+ *	| the hint is OS_HINT_SHORT and the rounded size fits. (C)
+ */
+void *os_malloc_hint(size_t size, int hint)
+{
+	if (size == 0)
+		return NULL;
+
+	size_t block_size = (size_t) align((size));
+
+	// (C)
+	if (hint & OS_HINT_ISOLATED) {
+		size_t line_size = isolated_size(block_size);
+
+		if ((hint & ~OS_HINT_ISOLATED) != OS_HINT_SHORT || line_size > SHORT_BLOCK_MAX)
+			return malloc_isolated(block_size);
+
+		heap_lock();
+		void *adr = add_isolated_short_block(line_size);
+
+		heap_unlock();
+		return adr;
+	}
+
+	// (A)
+	if (hint == OS_HINT_SHORT && block_size <= SHORT_BLOCK_MAX) {
+		heap_lock();
+		void *adr = add_short_block(block_size);
+
+		heap_unlock();
+		return adr;
 	}
+	// (B)
+	return os_malloc(size);
+}
+
+/**
+ * @param ptr - beginning address of a payload
+ * @param size - size requested when the payload was alloced
+ *	| Fast path of free() for callers that know the size of the block.
+ *	| The header in front of the payload is trusted if its size fits
+ *	| the given one, so the block isn't searched in the list. (A)
+ *	| Any other case falls back to os_free(). (B)
+ */
+void os_free_sized(void *ptr, size_t size)
+{
+	if (ptr == NULL)
+		return;
+
+	struct block_meta *block = (struct block_meta *)((char *)ptr - get_block_meta_size());
+
+	heap_lock();
+	// (A)
+	if (block->status == STATUS_ALLOC && block->size >= (size_t) align(size)) {
+		if (!tcache_push(block)) {
+			block->status = STATUS_FREE;
+			meta_table_sync(block);
+			stamp_free_block(block);
+		}
+	} else if (block->status == STATUS_ISOLATED && block->size >= (size_t) align(size)) {
+		free_isolated_block(block);
+	} else if (block->status == STATUS_MAPPED && block->size >= (size_t) align(size)) {
+		if (!defer_unmap(block))
+			delete_node(block);
+	} else {
+		// (B)
+		os_free(ptr);
+	}
+	heap_unlock();
+}
+
+/**
+ * @param alignment - alignment of the payload, a power of 2
+ * @param size - size of new payload
+ *	| Alignments up to ALIGNMENT are already given by malloc() (A),
+ *	| larger ones are handled by add_new_aligned_block(). (B)
+ */
+void *os_aligned_alloc(size_t alignment, size_t size)
+{
+	if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0)
+		return NULL;
+
+	// (A)
+	if (alignment <= ALIGNMENT)
+		return os_malloc(size);
+
+	// (B)
+	heap_lock();
+	void *adr = add_new_aligned_block((size_t) align(size), alignment);
+
+	heap_unlock();
+	return adr;
 }
 
 /**
@@ -72,6 +212,7 @@ void *os_calloc(size_t nmemb, size_t size)
 	size_t block_size = (size_t) align((total_size));
 	struct block_meta *best_fit = NULL;
 
+	heap_lock();
 	// (B)
 	if ((int) (size + get_block_meta_size()) < (int) getpagesize())
 		best_fit = (struct block_meta *)find_best_fit(block_size);
@@ -79,6 +220,7 @@ void *os_calloc(size_t nmemb, size_t size)
 		adr = add_new_block_calloc(block_size);
 	else
 		adr = (void *)((char *)best_fit + get_block_meta_size());
+	heap_unlock();
 
 	// (A)
 	if (adr != NULL) {
@@ -97,20 +239,29 @@ void *os_calloc(size_t nmemb, size_t size)
  *	| (B) When trying to realloc a NULL pointer, we call malloc on the
  *	|	  given size.
  *	| (C) When trying to realloc a freed block we return NULL
- *	| (D) When tring to realloc to a larger size than MMAP_TRESHOLD, we free
- *	|	  the block and call malloc.
+ *	| (D) When trying to realloc a mapped block, we resize the mapping
+ *	|	  with mremap() if it stays larger than MMAP_TRESHOLD, otherwise
+ *	|	  we free the block and call malloc.
  *	| (E) If a smaller size then we split the block if possibl, if not
- *	|	  we return the same block.
+ *	|	  we return the same block. Blocks that were repeatedly grown
+ *	|	  keep their headroom instead of being split.
  *	| (F) We then try to expand the blocks if possible (if the block is the
  *	|	  last one in the list or if it is followed by multiple free blocks
- *	|	  that can be coalesced together to form the requested size)
+ *	|	  that can be coalesced together to form the requested size),
+ *	|	  or by merging it with the free block placed before it.
  *	| (G) If expanding isn't possible, we apply the best fit rule and
  *	|	  coalesce all free blocks in the list to find a suitable
  *	|	  chunk of contiguous memory.
  *	| (H) Then we either move the block or expand the last free block
- *	|	  and copy the contents of the memory.
+ *	|	  and copy the contents of the memory. Blocks grown at least
+ *	|	  REALLOC_GROWTH_THRESHOLD times are given geometric headroom
+ *	|	  when they are moved or extended at the end of the heap, so
+ *	|	  repeated growth is served in place.
+ *	| (I) Short-lived blocks are moved to a new short-lived block.
+ *	| (J) Isolated blocks stay in place if the new size spans as many
+ *	|	  lines, otherwise they are moved to a new isolated block.
  */
-void *os_realloc(void *ptr, size_t size)
+static void *realloc_block(void *ptr, size_t size)
 {
 	// (A)
 	if (size == 0) {
@@ -122,7 +273,25 @@ void *os_realloc(void *ptr, size_t size)
 	if (ptr == NULL)
 		return os_malloc(size);
 
-	struct block_meta *block = (struct block_meta *)find_block((char *)ptr - get_block_meta_size());
+	struct block_meta *block = find_short_block(ptr);
+
+	// (I)
+	if (block != NULL) {
+		if (block->status != STATUS_SHORT)
+			return NULL;
+
+		void *adr = os_malloc_hint(size, OS_HINT_SHORT);
+
+		if (adr == NULL)
+			return NULL;
+		memcpy(adr, ptr, block->size < size ? block->size : size);
+		free_short_block(block);
+		return adr;
+	}
+
+	struct block_meta *prev;
+
+	block = (struct block_meta *)find_block((char *)ptr - get_block_meta_size(), &prev);
 
 	// (C)
 	if (block->status == STATUS_FREE)
@@ -130,22 +299,42 @@ void *os_realloc(void *ptr, size_t size)
 
 	size_t total_size = (size_t) align((size));
 
+	// (J)
+	if (block->status == STATUS_ISOLATED) {
+		if (isolated_size(total_size) == block->size)
+			return ptr;
+
+		void *adr = malloc_isolated(total_size);
+
+		memcpy(adr, ptr, block->size < total_size ? block->size : total_size);
+		free_isolated_block(block);
+		return adr;
+	}
+
 	// (D)
 	if (block->status == STATUS_MAPPED) {
-		int len = block->size;
+		if (total_size >= MMAP_THRESHOLD)
+			return remap_block_realloc(block, total_size);
 
-		if (len > align(size))
-			len = align(size);
+		size_t len = block->size;
+
+		if (len > total_size)
+			len = total_size;
 
 		void *adr = os_malloc(size);
 
+		PROFILE_BEGIN(sample);
 		memcpy(adr, (char *)ptr, len);
+		PROFILE_END(PHASE_REALLOC_COPY, sample);
 
 		os_free(ptr);
 		return adr;
 	}
 	if (block->status == STATUS_ALLOC) {
 		// (E)
+		if (block->grow_count >= REALLOC_GROWTH_THRESHOLD && block->size >= total_size
+			&& total_size + total_size / 2 >= block->size)
+			return (void *)((char *)block + get_block_meta_size());
 		if ((int) block->size > (int) (total_size +  get_block_meta_size())) {
 			split_block(block, total_size);
 			return (void *)((char *)block + get_block_meta_size());
@@ -154,33 +343,145 @@ void *os_realloc(void *ptr, size_t size)
 			return (void *)((char *)block + get_block_meta_size());
 
 		// (F)
+		block->grow_count++;
+		size_t grow_size = realloc_growth_size(block, total_size);
 		struct block_meta *best_fit = (struct block_meta *)try_realloc_expanding(block, total_size);
 
 		if (best_fit == NULL) {
+			void *adr1 = expand_block_backward(block, prev, total_size);
+
+			if (adr1 != NULL)
+				return adr1;
+
 			// (G)
-			void *adr2 = find_free_block_realloc(block, total_size);
+			void *adr2 = find_free_block_realloc(block, grow_size);
 
 			if (adr2 == NULL) {
 				struct block_meta *last = find_last();
 
 				// (H)
-				if (last->status == STATUS_FREE && total_size + get_block_meta_size() < MMAP_THRESHOLD) {
-					void *adr3 = expand_last_free(last, total_size);
+				if (last->status == STATUS_FREE && grow_size + get_block_meta_size() < MMAP_THRESHOLD) {
+					void *adr3 = expand_last_free(last, grow_size);
 
+					last->grow_count = block->grow_count;
+					PROFILE_BEGIN(sample);
 					memcpy(adr3, (char *)block + get_block_meta_size(), block->size);
+					PROFILE_END(PHASE_REALLOC_COPY, sample);
 					block->status = STATUS_FREE;
+					meta_table_sync(block);
+					stamp_free_block(block);
 					return adr3;
 				}
-				return move_block_realloc(block, total_size);
+				return move_block_realloc(block, grow_size);
 			} else {
 				return (char *)adr2 + get_block_meta_size();
 			}
 		} else {
 			if (best_fit == block)
-				return expand_last_block_realloc(block, total_size);
+				return expand_last_block_realloc(block, grow_size);
 
 			return expand_block_realloc(block, total_size);
 		}
 	}
 	return NULL;
 }
+
+/**
+ * @param ptr - beginning adress of the payload
+ * @param size - size of the new payload
+ *	| Reallocs the block while holding the list lock, see realloc_block().
+ */
+void *os_realloc(void *ptr, size_t size)
+{
+	heap_lock();
+	void *adr = realloc_block(ptr, size);
+
+	heap_unlock();
+	return adr;
+}
+
+/**
+ * @param policy - one of the OS_FIT_* values
+ *	| Selects the policy used when searching a free block for reuse.
+ */
+void os_set_fit_policy(int policy)
+{
+	set_fit_policy(policy);
+}
+
+/**
+ * @param enable - whether the side tables are used
+ *	| Enables or disables the side tables used by the heap walks.
+ */
+void os_set_meta_table(int enable)
+{
+	heap_lock();
+	set_meta_table(enable);
+	heap_unlock();
+}
+
+/**
+ * @param interval_ms - time between two scavenger passes
+ * @param decay_ms - time a free block stays idle before it is released
+ * @param headroom - idle free memory kept resident
+ * @param rate_limit - maximum number of bytes released per pass
+ *	| Starts the background scavenger thread.
+ */
+int os_scavenger_start(unsigned int interval_ms, unsigned int decay_ms, size_t headroom, size_t rate_limit)
+{
+	return scavenger_start(interval_ms, decay_ms, headroom, rate_limit);
+}
+
+/**
+ *	| Stops the background scavenger thread.
+ */
+void os_scavenger_stop(void)
+{
+	scavenger_stop();
+}
+
+/**
+ * @param fd - file descriptor
+ *	| Writes the per phase timing histograms, available when the
+ *	| library is built with PROFILE=1.
+ */
+int os_profile_dump(int fd)
+{
+	return profile_dump(fd);
+}
+
+/**
+ *	| Clears the per phase timing histograms.
+ */
+void os_profile_reset(void)
+{
+	profile_reset();
+}
+
+/**
+ * @param fd - file descriptor
+ *	| Writes a binary snapshot of every block in the list, see heap_dump().
+ */
+int os_heap_dump(int fd)
+{
+	return heap_dump(fd);
+}
+
+/**
+ * @param size - size whose class is changed
+ * @param enable - whether the blocks of the class are isolated
+ *	| Sets the isolation policy of a small size class.
+ */
+int os_set_isolated_class(size_t size, int enable)
+{
+	if (size == 0 || size > OS_SMALL_MAX)
+		return -1;
+
+	unsigned int size_class = os_size_class_of(size);
+
+	if (enable)
+		os_isolated_classes |= 1u << size_class;
+	else
+		os_isolated_classes &= ~(1u << size_class);
+	return 0;
+}
@@ -7,7 +7,105 @@
 #include <stdio.h>
 #include "printf.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Fit policies used for block reuse, see os_set_fit_policy() */
+#define OS_FIT_BEST  0
+#define OS_FIT_FIRST 1
+#define OS_FIT_NEXT  2
+#define OS_FIT_GOOD  3
+
+/* Lifetime hints, see os_malloc_hint() */
+#define OS_HINT_NONE  0
+#define OS_HINT_SHORT 1
+#define OS_HINT_LONG  2
+/* Flag that can be added to any of the hints, see os_malloc_hint() */
+#define OS_HINT_ISOLATED 4
+
 void *os_malloc(size_t size);
 void os_free(void *ptr);
 void *os_calloc(size_t nmemb, size_t size);
 void *os_realloc(void *ptr, size_t size);
+
+/*
+ * Allocates size bytes with a lifetime hint. OS_HINT_SHORT blocks are
+ * carved from separate mapped segments, which are reset or unmapped as a
+ * whole once all their blocks are freed, so short-lived blocks don't
+ * fragment the heap holding long-lived ones. Other hints use os_malloc().
+ * With OS_HINT_ISOLATED, the block gets cache lines of its own: the
+ * payload starts on a line boundary and no other block's data shares its
+ * lines. Small isolated blocks are carved from a per-thread chunk, or
+ * from the short-lived segments when combined with OS_HINT_SHORT.
+ */
+void *os_malloc_hint(size_t size, int hint);
+/*
+ * Makes every os_malloc() request in the size class of size isolated as
+ * with OS_HINT_ISOLATED (enable != 0) or not. Only sizes up to
+ * OS_SMALL_MAX (osmem_inline.h) have a class, returns -1 for others.
+ */
+int os_set_isolated_class(size_t size, int enable);
+
+/*
+ * Allocates size bytes whose address is a multiple of alignment, which
+ * must be a power of 2. The block is freed with os_free().
+ */
+void *os_aligned_alloc(size_t alignment, size_t size);
+/*
+ * Frees a block whose requested size is known to the caller. The header
+ * is checked directly instead of searching the block in the list.
+ */
+void os_free_sized(void *ptr, size_t size);
+
+/*
+ * Selects the fit policy, overriding the OSMEM_FIT_POLICY environment
+ * variable ("best", "first", "next" or "good").
+ */
+void os_set_fit_policy(int policy);
+/*
+ * Enables (enable != 0) or disables the side tables that hold the size and
+ * status of every brk() block, so that fit searches and coalescing walk
+ * dense arrays instead of the block headers. Overrides the
+ * OSMEM_META_TABLE environment variable ("1" enables them).
+ */
+void os_set_meta_table(int enable);
+
+/*
+ * Starts a background thread that, every interval_ms, releases the pages
+ * of free heap blocks idle for longer than decay_ms with madvise() and
+ * unmaps the mapped blocks freed in the meantime. At most rate_limit bytes
+ * are released per pass and up to headroom bytes of idle free memory are
+ * kept resident.
+ * Returns 0 on success, -1 if it is already running or can't be started.
+ */
+int os_scavenger_start(unsigned int interval_ms, unsigned int decay_ms, size_t headroom, size_t rate_limit);
+/*
+ * Stops the scavenger thread and unmaps the mapped blocks still pending.
+ */
+void os_scavenger_stop(void);
+
+/*
+ * Writes the time spent in each allocator phase (coalesce, fit search,
+ * split, heap growth, block lookup and realloc copy) as text histograms.
+ * Only available when the library is built with PROFILE=1, in which case
+ * the same dump is also written to stderr at exit. Setting
+ * OSMEM_PROFILE_PERF adds cycles, cache and dTLB misses read with
+ * perf_event_open(). Returns -1 if profiling is not built in.
+ */
+int os_profile_dump(int fd);
+void os_profile_reset(void);
+
+/*
+ * Writes a binary snapshot of every block (address, size, status and
+ * segment) to fd, in the format described in heap_dump.h. The walk does
+ * not allocate memory from the heap and no system call is made while the
+ * list lock is held. `make tools` builds heap_stat, which turns the
+ * snapshot into fragmentation metrics and a free space histogram.
+ * Returns 0 on success, -1 on write or mapping errors.
+ */
+int os_heap_dump(int fd);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * C++ adaptors for the os_*() allocator: a std::pmr::memory_resource, a
+ * region resource built on top of it and an STL allocator. Deallocation
+ * passes the size of the block to os_free_sized(), so containers never
+ * search the block in the list, and over-aligned types are served by
+ * os_aligned_alloc().
+ */
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include "osmem.h"
+
+namespace osmem {
+
+/* Alignment of every os_malloc() payload (ALIGNMENT in alignment_utils.h) */
+inline constexpr std::size_t min_alignment = 8;
+
+inline void *allocate(std::size_t bytes, std::size_t alignment)
+{
+	if (bytes == 0)
+		bytes = 1;
+
+	void *ptr = alignment <= min_alignment ? os_malloc(bytes) : os_aligned_alloc(alignment, bytes);
+
+	if (ptr == nullptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+inline void deallocate(void *ptr, std::size_t bytes)
+{
+	os_free_sized(ptr, bytes == 0 ? 1 : bytes);
+}
+
+/*
+ * Memory resource backed by the os_*() heap. All instances share the same
+ * heap, so any two of them compare equal.
+ */
+class memory_resource : public std::pmr::memory_resource {
+protected:
+	void *do_allocate(std::size_t bytes, std::size_t alignment) override
+	{
+		return osmem::allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void *ptr, std::size_t bytes, std::size_t) override
+	{
+		osmem::deallocate(ptr, bytes);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+	{
+		return dynamic_cast<const memory_resource *>(&other) != nullptr;
+	}
+};
+
+inline memory_resource *default_resource() noexcept
+{
+	static memory_resource resource;
+
+	return &resource;
+}
+
+/*
+ * Per-container region: allocations are carved from chunks taken from the
+ * os_*() heap and released all at once when the region is destroyed.
+ */
+class region_resource : public std::pmr::monotonic_buffer_resource {
+public:
+	explicit region_resource(std::size_t initial_size = 4096)
+		: std::pmr::monotonic_buffer_resource(initial_size, default_resource())
+	{
+	}
+};
+
+/*
+ * STL allocator using the os_*() heap directly, without the virtual calls
+ * of std::pmr::polymorphic_allocator.
+ */
+template <class T>
+class allocator {
+public:
+	using value_type = T;
+
+	allocator() noexcept = default;
+
+	template <class U>
+	allocator(const allocator<U> &) noexcept
+	{
+	}
+
+	T *allocate(std::size_t n)
+	{
+		if (n > static_cast<std::size_t>(-1) / sizeof(T))
+			throw std::bad_array_new_length();
+		return static_cast<T *>(osmem::allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *ptr, std::size_t n) noexcept
+	{
+		osmem::deallocate(ptr, n * sizeof(T));
+	}
+};
+
+template <class T, class U>
+bool operator==(const allocator<T> &, const allocator<U> &) noexcept
+{
+	return true;
+}
+
+template <class T, class U>
+bool operator!=(const allocator<T> &, const allocator<U> &) noexcept
+{
+	return false;
+}
+
+} // namespace osmem
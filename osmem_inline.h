@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Inline fast path for small allocations. Requests up to OS_SMALL_MAX
+ * bytes are rounded to one of OS_SIZE_CLASSES size classes and popped
+ * from a per-thread list of cached blocks, without taking the list lock.
+ * Blocks freed with os_free() are pushed back to the list of the freeing
+ * thread, with a cached status that makes a second free of them a no-op. Only misses call into the library, which refills the list in
+ * batches. Constant sizes resolve to a class at compile time.
+ */
+#include <stddef.h>
+#include "osmem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OS_SMALL_MAX    256
+#define OS_SIZE_CLASSES 12
+/* Maximum number of blocks cached per class and thread */
+#define OS_TCACHE_MAX   32
+/* Number of blocks carved at once when the list of a class is empty */
+#define OS_TCACHE_BATCH 8
+
+/* Size class of a size in (0, OS_SMALL_MAX], usable in constant expressions */
+#define OS_CLASS_OF(size)                                                                  \
+	((size) <= 8 ? 0 : (size) <= 16 ? 1 : (size) <= 24 ? 2 : (size) <= 32 ? 3 :       \
+	 (size) <= 48 ? 4 : (size) <= 64 ? 5 : (size) <= 80 ? 6 : (size) <= 96 ? 7 :     \
+	 (size) <= 128 ? 8 : (size) <= 160 ? 9 : (size) <= 192 ? 10 : 11)
+
+#define OS_CLASS_ROW(size) \
+	OS_CLASS_OF(size), OS_CLASS_OF((size) + 8), OS_CLASS_OF((size) + 16), OS_CLASS_OF((size) + 24)
+
+/* Size of each class */
+static const unsigned short os_class_size[OS_SIZE_CLASSES] = {
+	8, 16, 24, 32, 48, 64, 80, 96, 128, 160, 192, 256
+};
+
+/* Class of every size, indexed by (size + 7) / 8, generated at compile time */
+static const unsigned char os_size_class[OS_SMALL_MAX / 8 + 1] = {
+	OS_CLASS_ROW(0), OS_CLASS_ROW(32), OS_CLASS_ROW(64), OS_CLASS_ROW(96),
+	OS_CLASS_ROW(128), OS_CLASS_ROW(160), OS_CLASS_ROW(192), OS_CLASS_ROW(224),
+	OS_CLASS_OF(256)
+};
+
+/*
+ * Status of a popped block and distance from a payload back to the
+ * status in its header, checked against helpers.h in tcache.c
+ */
+#define OS_STATUS_ALLOC  1
+#define OS_STATUS_OFFSET 16
+
+/* Per-thread lists of cached blocks, linked through their first word */
+struct os_tcache {
+	void *head[OS_SIZE_CLASSES];
+	unsigned int count[OS_SIZE_CLASSES];
+};
+
+extern __thread struct os_tcache os_tcache;
+/* Size classes whose blocks are isolated on their own cache lines */
+extern unsigned int os_isolated_classes;
+
+/* Slow path, called when the list of the class is empty */
+void *os_malloc_small_miss(unsigned int size_class);
+
+static inline unsigned int os_size_class_of(size_t size)
+{
+	if (__builtin_constant_p(size))
+		return OS_CLASS_OF(size);
+	return os_size_class[(size + 7) >> 3];
+}
+
+static inline void *os_malloc_small(size_t size)
+{
+	if (size == 0 || size > OS_SMALL_MAX)
+		return os_malloc(size);
+
+	unsigned int size_class = os_size_class_of(size);
+
+	if (__builtin_expect(os_isolated_classes & (1u << size_class), 0))
+		return os_malloc_hint(size, OS_HINT_ISOLATED);
+
+	void *ptr = os_tcache.head[size_class];
+
+	if (__builtin_expect(ptr != NULL, 1)) {
+		os_tcache.head[size_class] = *(void **)ptr;
+		os_tcache.count[size_class]--;
+		*(int *)((char *)ptr - OS_STATUS_OFFSET) = OS_STATUS_ALLOC;
+		return ptr;
+	}
+	return os_malloc_small_miss(size_class);
+}
+
+#ifdef __cplusplus
+}
+#endif
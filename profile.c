@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/**
+ * @name Dumitrescu Alexandra
+ * @date 10.04.2023
+ * @for  Operating Systems - Memory Allocator
+ */
+#include <unistd.h>
+#include "profile.h"
+
+#ifdef OSMEM_PROFILE
+#include <pthread.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+/**
+ * Stats of one phase: number of samples, total ticks, total hardware
+ * counter values and the histogram of ticks in log2 buckets. They are
+ * shared by all threads and only updated with atomic adds.
+ */
+struct phase_stats {
+	uint64_t count;
+	uint64_t ticks;
+	uint64_t counters[PROFILE_COUNTERS];
+	uint64_t histogram[PROFILE_BUCKETS];
+};
+
+struct phase_stats phase_stats[PHASE_COUNT];
+
+static const char *phase_names[PHASE_COUNT] = {
+	"coalesce", "fit_search", "split_block", "heap_growth", "find_block", "realloc_copy"
+};
+
+static const char *counter_names[PROFILE_COUNTERS] = {
+	"cycles", "cache_misses", "dtlb_misses"
+};
+
+/**
+ * perf_event_open() group leader of the calling thread, -2 before the
+ * counters are opened and -1 if they are disabled or unavailable, and
+ * the other counters of the group.
+ */
+static __thread int perf_group_fd = -2;
+static __thread int perf_member_fds[PROFILE_COUNTERS - 1];
+/**
+ * Key whose destructor closes the counters of an exiting thread
+ */
+static pthread_key_t perf_key;
+static pthread_once_t perf_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @param field - stats field shared by all threads
+ * @param value - value that is added
+ *	| Adds the value without a lock. The stats are only summed, so
+ *	| relaxed ordering is enough.
+ */
+static inline void stats_add(uint64_t *field, uint64_t value)
+{
+	__atomic_fetch_add(field, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @param copy - stats read
+ * @param stats - stats of a phase, possibly being updated
+ *	| Reads the stats field by field with atomic loads. The fields
+ *	| are all uint64_t, so the struct is walked as an array of them.
+ */
+static void stats_load(struct phase_stats *copy, struct phase_stats *stats)
+{
+	uint64_t *dst = (uint64_t *)copy;
+	uint64_t *src = (uint64_t *)stats;
+
+	for (size_t i = 0; i < sizeof(*stats) / sizeof(uint64_t); i++)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+}
+
+/**
+ * @param arg - unused, the descriptors are those of the exiting thread
+ *	| Closes the counter group of the exiting thread.
+ */
+static void perf_close(void *arg)
+{
+	(void)arg;
+	if (perf_group_fd < 0)
+		return;
+	for (int i = 0; i < PROFILE_COUNTERS - 1; i++)
+		close(perf_member_fds[i]);
+	close(perf_group_fd);
+	perf_group_fd = -1;
+}
+
+/**
+ *	| Creates the key whose destructor is perf_close().
+ */
+static void perf_key_create(void)
+{
+	pthread_key_create(&perf_key, perf_close);
+}
+
+/**
+ * @param type - perf event type
+ * @param config - perf event config
+ * @param group_fd - group leader or -1 for the leader itself
+ *	| Opens one counter of the calling thread, user space only.
+ */
+static int perf_open(uint32_t type, uint64_t config, int group_fd)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/**
+ *	| Opens the counter group of the calling thread if OSMEM_PROFILE_PERF
+ *	| is set. If any counter is unavailable, the counters are disabled
+ *	| and only ticks are recorded. The group is closed when the thread
+ *	| exits.
+ */
+static void perf_init(void)
+{
+	perf_group_fd = -1;
+	if (getenv("OSMEM_PROFILE_PERF") == NULL)
+		return;
+
+	int leader = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+
+	if (leader == -1)
+		return;
+
+	int cache = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, leader);
+	int dtlb = perf_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), leader);
+
+	if (cache == -1 || dtlb == -1) {
+		if (cache != -1)
+			close(cache);
+		if (dtlb != -1)
+			close(dtlb);
+		close(leader);
+		return;
+	}
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	perf_member_fds[0] = cache;
+	perf_member_fds[1] = dtlb;
+	perf_group_fd = leader;
+	pthread_once(&perf_once, perf_key_create);
+	pthread_setspecific(perf_key, &perf_group_fd);
+}
+
+/**
+ * @param counters - array where the counter values are stored
+ *	| Reads all the counters of the group with one read() call.
+ */
+static void perf_read(uint64_t *counters)
+{
+	uint64_t values[PROFILE_COUNTERS + 1];
+
+	if (read(perf_group_fd, values, sizeof(values)) != (ssize_t)sizeof(values))
+		memset(values, 0, sizeof(values));
+	memcpy(counters, values + 1, PROFILE_COUNTERS * sizeof(uint64_t));
+}
+
+void profile_begin(struct profile_sample *sample)
+{
+	if (perf_group_fd == -2)
+		perf_init();
+	if (perf_group_fd >= 0)
+		perf_read(sample->counters);
+	sample->ticks = read_ticks();
+}
+
+void profile_end(int phase, struct profile_sample *sample)
+{
+	uint64_t ticks = read_ticks() - sample->ticks;
+	struct phase_stats *stats = &phase_stats[phase];
+
+	if (perf_group_fd >= 0) {
+		uint64_t counters[PROFILE_COUNTERS];
+
+		perf_read(counters);
+		for (int i = 0; i < PROFILE_COUNTERS; i++)
+			stats_add(&stats->counters[i], counters[i] - sample->counters[i]);
+	}
+	stats_add(&stats->count, 1);
+	stats_add(&stats->ticks, ticks);
+	stats_add(&stats->histogram[63 - __builtin_clzll(ticks | 1)], 1);
+}
+
+/**
+ * @param fd - file descriptor
+ * @param buf - buffer with len bytes
+ *	| Writes the whole buffer, the dump doesn't use stdio so that it
+ *	| never allocates memory.
+ */
+static int write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t res = write(fd, buf, len);
+
+		if (res <= 0)
+			return -1;
+		buf += res;
+		len -= res;
+	}
+	return 0;
+}
+
+int profile_dump(int fd)
+{
+	char line[256];
+	int len;
+
+	for (int phase = 0; phase < PHASE_COUNT; phase++) {
+		struct phase_stats copy;
+		struct phase_stats *stats = &copy;
+
+		stats_load(&copy, &phase_stats[phase]);
+		if (stats->count == 0)
+			continue;
+
+		len = snprintf(line, sizeof(line), "%s: count=%llu ticks=%llu avg=%llu", phase_names[phase],
+				(unsigned long long)stats->count, (unsigned long long)stats->ticks,
+				(unsigned long long)(stats->ticks / stats->count));
+		for (int i = 0; i < PROFILE_COUNTERS; i++) {
+			if (stats->counters[i] != 0)
+				len += snprintf(line + len, sizeof(line) - len, " %s=%llu", counter_names[i],
+						(unsigned long long)stats->counters[i]);
+		}
+		len += snprintf(line + len, sizeof(line) - len, "\n");
+		if (write_all(fd, line, len) == -1)
+			return -1;
+
+		for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+			if (stats->histogram[bucket] == 0)
+				continue;
+			len = snprintf(line, sizeof(line), "  [%llu, %llu) ticks: %llu\n", bucket == 0 ? 0 : 1ULL << bucket,
+					bucket == 63 ? ~0ULL : 1ULL << (bucket + 1), (unsigned long long)stats->histogram[bucket]);
+			if (write_all(fd, line, len) == -1)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+void profile_reset(void)
+{
+	uint64_t *field = (uint64_t *)phase_stats;
+
+	for (size_t i = 0; i < PHASE_COUNT * sizeof(struct phase_stats) / sizeof(uint64_t); i++)
+		__atomic_store_n(&field[i], 0, __ATOMIC_RELAXED);
+}
+
+/**
+ *	| Dumps the stats to stderr when the program exits.
+ */
+__attribute__((destructor)) static void profile_dump_at_exit(void)
+{
+	profile_dump(STDERR_FILENO);
+}
+#else
+int profile_dump(int fd)
+{
+	(void)fd;
+	return -1;
+}
+
+void profile_reset(void)
+{
+}
+#endif
@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+#include <stdint.h>
+#include "helpers.h"
+/*
+    @name Dumitrescu Alexandra
+    @date 10.04.2023
+    @for  Operating Systems - Memory Allocator
+*/
+
+/*
+    Phases of the allocator that are timed when the library is built
+    with OSMEM_PROFILE (make PROFILE=1). PHASE_COALESCE times each run
+    of merged free blocks, which happens inside the fit search, so its
+    time is also part of PHASE_FIT_SEARCH.
+*/
+#define PHASE_COALESCE     0
+#define PHASE_FIT_SEARCH   1
+#define PHASE_SPLIT        2
+#define PHASE_HEAP_GROWTH  3
+#define PHASE_FIND_BLOCK   4
+#define PHASE_REALLOC_COPY 5
+#define PHASE_COUNT        6
+/*
+    Number of log2 buckets in the histogram of each phase and number of
+    hardware counters read with perf_event_open() (cycles, cache misses
+    and dTLB misses) when OSMEM_PROFILE_PERF is set in the environment.
+*/
+#define PROFILE_BUCKETS  64
+#define PROFILE_COUNTERS 3
+
+#ifdef OSMEM_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+struct profile_sample {
+	uint64_t ticks;
+	uint64_t counters[PROFILE_COUNTERS];
+};
+
+/*
+    Returns the time stamp counter, or the monotonic clock in
+    nanoseconds on architectures without one.
+*/
+static inline uint64_t read_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/*
+    @param sample - sample that stores the start of the phase
+
+    | Methods called at the start and at the end of a timed phase, the
+    | second one adds the elapsed ticks and counters to the phase stats.
+*/
+void profile_begin(struct profile_sample *sample);
+void profile_end(int phase, struct profile_sample *sample);
+
+#define PROFILE_BEGIN(sample) struct profile_sample sample; profile_begin(&sample)
+#define PROFILE_END(phase, sample) profile_end((phase), &sample)
+#else
+#define PROFILE_BEGIN(sample) do { } while (0)
+#define PROFILE_END(phase, sample) do { } while (0)
+#endif
+
+/*
+    @param fd - file descriptor where the stats are written
+
+    | Writes the stats and histograms of all the phases as text.
+    | Returns -1 if the library wasn't built with OSMEM_PROFILE.
+*/
+int profile_dump(int fd);
+/*
+    | Clears the stats of all the phases.
+*/
+void profile_reset(void);
@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/**
+ * @name Dumitrescu Alexandra
+ * @date 10.04.2023
+ * @for  Operating Systems - Memory Allocator
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/single_threaded.h>
+#include <time.h>
+#include <unistd.h>
+#include "scavenger.h"
+#include "alignment_utils.h"
+#include "allocator.h"
+
+extern struct block_meta *heap_head;
+extern struct block_meta *heap_last;
+
+/**
+ * Lock of the list, taken by the os_*() functions, the scavenger thread
+ * and the slow path of the small allocation caches. It is recursive
+ * since realloc() calls malloc() and free().
+ */
+pthread_mutex_t list_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+/**
+ * Value set once the library starts a thread of its own. Together with
+ * __libc_single_threaded, which glibc clears before the first thread
+ * is created and never sets again, it tells whether the lock is needed.
+ */
+int heap_shared;
+/**
+ * Lock and condition used by the scavenger thread to sleep between
+ * passes and to be woken up when it is stopped.
+ */
+pthread_mutex_t scavenger_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t scavenger_wait_cond = PTHREAD_COND_INITIALIZER;
+pthread_t scavenger_thread;
+/**
+ * Value set while the scavenger thread is running, respectively
+ * when it is asked to stop. The first one is read by the free path,
+ * so it is only changed while holding the list lock.
+ */
+int scavenger_running;
+int scavenger_stopping;
+/**
+ * Number of the current scavenger pass, used as the clock for
+ * measuring how long free blocks stay idle.
+ */
+size_t scavenge_epoch = 1;
+/**
+ * Scavenger settings: time between passes, number of passes a free
+ * block has to stay idle before its pages are released, idle free
+ * memory that is kept resident and bytes released per pass.
+ */
+unsigned int scavenge_interval_ms;
+size_t scavenge_decay_passes;
+size_t scavenge_headroom;
+size_t scavenge_rate_limit;
+/**
+ * Mapped blocks freed while the scavenger is running, linked through
+ * their next field and waiting for munmap().
+ */
+struct block_meta *pending_unmaps;
+
+/**
+ *	| The lock is skipped while the process has a single thread, so
+ *	| single-threaded programs don't pay for it on every call. The
+ *	| answer can't change between a lock and its unlock: no other
+ *	| thread can be created meanwhile, except by scavenger_start(),
+ *	| which sets heap_shared before taking the lock.
+ */
+static inline int heap_needs_lock(void)
+{
+	return heap_shared || !__libc_single_threaded;
+}
+
+void heap_lock(void)
+{
+	if (heap_needs_lock())
+		pthread_mutex_lock(&list_lock);
+}
+
+void heap_unlock(void)
+{
+	if (heap_needs_lock())
+		pthread_mutex_unlock(&list_lock);
+}
+
+void stamp_free_block(struct block_meta *block)
+{
+	if (scavenger_running && block->size >= sizeof(size_t))
+		*(size_t *)((char *)block + get_block_meta_size()) = scavenge_epoch;
+}
+
+/**
+ * @param block - free block that absorbs the next one
+ * @param next - free block that is absorbed
+ *	| The merged block keeps the most recent stamp, so the part freed
+ *	| last still waits the whole decay interval. A released block takes
+ *	| the stamp of a resident one, so the resident part is still counted
+ *	| and released later.
+ */
+void merge_stamps(struct block_meta *block, struct block_meta *next)
+{
+	if (!scavenger_running || block->status != STATUS_FREE || next->status != STATUS_FREE
+		|| block->size < sizeof(size_t) || next->size < sizeof(size_t))
+		return;
+
+	size_t *stamp = (size_t *)((char *)block + get_block_meta_size());
+	size_t next_stamp = *(size_t *)((char *)next + get_block_meta_size());
+
+	if (*stamp == SCAVENGED_STAMP || (next_stamp != SCAVENGED_STAMP && next_stamp > *stamp))
+		*stamp = next_stamp;
+}
+
+int defer_unmap(struct block_meta *block)
+{
+	if (!scavenger_running)
+		return 0;
+
+	unlink_node(block);
+	block->next = pending_unmaps;
+	pending_unmaps = block;
+	return 1;
+}
+
+/**
+ * @param limit - maximum number of bytes to unmap
+ *	| Unmaps pending mapped blocks whose whole mapping, counted from
+ *	| mapping_start(), fits in what is left of the limit (A). The first
+ *	| one that doesn't fit has pages unmapped from its end up to the
+ *	| limit and stays pending for the next pass (B). Returns the number
+ *	| of bytes released.
+ */
+static size_t release_pending_unmaps(size_t limit)
+{
+	size_t released = 0;
+
+	while (pending_unmaps != NULL && released < limit) {
+		struct block_meta *block = pending_unmaps;
+		size_t len = mapping_length(block);
+
+		// (A)
+		if (len <= limit - released) {
+			pending_unmaps = block->next;
+			unmap_block(block);
+			released += len;
+			continue;
+		}
+
+		// (B)
+		released += trim_mapping(block, limit - released);
+		break;
+	}
+	return released;
+}
+
+/**
+ * @param block - free brk() block
+ * @param start - set to the first page that can be released
+ *	| Returns the number of bytes of whole pages inside the payload of
+ *	| the block, after the stamp, that can be given back to the kernel.
+ */
+static size_t releasable_bytes(struct block_meta *block, char **start)
+{
+	uintptr_t page_size = getpagesize();
+	uintptr_t payload = (uintptr_t)block + get_block_meta_size();
+	uintptr_t first = (payload + sizeof(size_t) + page_size - 1) & ~(page_size - 1);
+	uintptr_t last = (payload + block->size) & ~(page_size - 1);
+
+	*start = (char *)first;
+	return last > first ? last - first : 0;
+}
+
+/**
+ *	| One scavenger pass. Pending unmaps are released first (A). Then
+ *	| adjacent free blocks are coalesced, so small freed blocks form
+ *	| whole pages, the resident idle memory is summed up (B) and the
+ *	| pages of blocks idle for at least the decay interval are released
+ *	| with madvise() while the resident idle memory is larger than the
+ *	| headroom (C). A stamp from a later pass than the current one can
+ *	| only be stale payload data, so the block is stamped again. (D)
+ *	| All steps stop once the rate limit is reached.
+ */
+void scavenge(void)
+{
+	heap_lock();
+
+	// (A)
+	size_t released = release_pending_unmaps(scavenge_rate_limit);
+	size_t resident = 0;
+	char *start;
+
+	// (B)
+	coalesce();
+	for (struct block_meta *ptr = heap_head; ptr != brk_end(); ptr = ptr->next) {
+		if (ptr->status == STATUS_FREE && ptr->size >= sizeof(size_t)
+			&& *(size_t *)((char *)ptr + get_block_meta_size()) != SCAVENGED_STAMP)
+			resident += releasable_bytes(ptr, &start);
+	}
+
+	// (C)
+	for (struct block_meta *ptr = heap_head; ptr != brk_end(); ptr = ptr->next) {
+		if (resident <= scavenge_headroom || released >= scavenge_rate_limit)
+			break;
+		if (ptr->status == STATUS_FREE && ptr->size >= sizeof(size_t)) {
+			size_t *stamp = (size_t *)((char *)ptr + get_block_meta_size());
+			size_t len = releasable_bytes(ptr, &start);
+
+			// (D)
+			if (*stamp != SCAVENGED_STAMP && *stamp > scavenge_epoch)
+				*stamp = scavenge_epoch;
+			if (*stamp != SCAVENGED_STAMP && len > 0 && scavenge_epoch - *stamp >= scavenge_decay_passes) {
+				int result = madvise(start, len, MADV_DONTNEED);
+
+				DIE(result == -1, "Madvise failed!\n");
+				*stamp = SCAVENGED_STAMP;
+				resident -= len;
+				released += len;
+			}
+		}
+	}
+	scavenge_epoch++;
+
+	heap_unlock();
+}
+
+/**
+ *	| Body of the scavenger thread, runs one pass every interval
+ *	| until it is asked to stop.
+ */
+static void *scavenger_loop(void *arg)
+{
+	(void)arg;
+	pthread_mutex_lock(&scavenger_wait_lock);
+	while (!scavenger_stopping) {
+		struct timespec deadline;
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += scavenge_interval_ms / 1000;
+		deadline.tv_nsec += (long)(scavenge_interval_ms % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&scavenger_wait_cond, &scavenger_wait_lock, &deadline);
+		if (scavenger_stopping)
+			break;
+
+		pthread_mutex_unlock(&scavenger_wait_lock);
+		scavenge();
+		pthread_mutex_lock(&scavenger_wait_lock);
+	}
+	pthread_mutex_unlock(&scavenger_wait_lock);
+	return NULL;
+}
+
+/**
+ * @param interval_ms - time between two passes
+ * @param decay_ms - time a free block has to stay idle to be released
+ * @param headroom - idle free memory that is kept resident
+ * @param rate_limit - maximum number of bytes released per pass
+ *	| Starts the scavenger thread. Returns -1 if it is already running
+ *	| or the thread can't be created. From now on the list lock is
+ *	| taken even if no other thread exists yet. It is held, so no
+ *	| free() sees the scavenger running before the thread exists.
+ *	| Blocks freed while it wasn't running have no stamp yet, they are
+ *	| stamped with the first pass. (A)
+ */
+int scavenger_start(unsigned int interval_ms, unsigned int decay_ms, size_t headroom, size_t rate_limit)
+{
+	if (interval_ms == 0)
+		return -1;
+
+	heap_shared = 1;
+	heap_lock();
+	if (scavenger_running) {
+		heap_unlock();
+		return -1;
+	}
+
+	scavenge_interval_ms = interval_ms;
+	scavenge_decay_passes = (decay_ms + interval_ms - 1) / interval_ms;
+	scavenge_headroom = headroom;
+	scavenge_rate_limit = rate_limit;
+	scavenger_stopping = 0;
+
+	int result = pthread_create(&scavenger_thread, NULL, scavenger_loop, NULL);
+
+	if (result == 0) {
+		scavenger_running = 1;
+		// (A)
+		for (struct block_meta *ptr = heap_head; ptr != brk_end(); ptr = ptr->next) {
+			if (ptr->status == STATUS_FREE)
+				stamp_free_block(ptr);
+		}
+	}
+	heap_unlock();
+
+	return result == 0 ? 0 : -1;
+}
+
+/**
+ *	| Stops the scavenger thread (A) and then, holding the list lock
+ *	| so that no free() is deferring an unmap meanwhile, unmaps all the
+ *	| pending blocks and clears the running flag. (B)
+ */
+void scavenger_stop(void)
+{
+	heap_lock();
+	int running = scavenger_running;
+
+	heap_unlock();
+	if (!running)
+		return;
+
+	// (A)
+	pthread_mutex_lock(&scavenger_wait_lock);
+	if (scavenger_stopping) {
+		pthread_mutex_unlock(&scavenger_wait_lock);
+		return;
+	}
+	scavenger_stopping = 1;
+	pthread_cond_signal(&scavenger_wait_cond);
+	pthread_mutex_unlock(&scavenger_wait_lock);
+	pthread_join(scavenger_thread, NULL);
+
+	// (B)
+	heap_lock();
+	release_pending_unmaps(SIZE_MAX);
+	scavenger_running = 0;
+	heap_unlock();
+}
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+#include "helpers.h"
+/*
+    @name Dumitrescu Alexandra
+    @date 10.04.2023
+    @for  Operating Systems - Memory Allocator
+*/
+
+/*
+    Stamp written in the payload of a free block whose pages were
+    already released by the scavenger.
+*/
+#define SCAVENGED_STAMP ((size_t)-1)
+
+/*
+    | Methods used by the os_*() functions, the scavenger thread and
+    | the small allocation caches to serialise access to the list. The
+    | lock is only taken once the process has more than one thread.
+*/
+void heap_lock(void);
+void heap_unlock(void);
+/*
+    @param block - brk() block that was just freed
+
+    | Method called whenever a brk() block becomes free that records the
+    | scavenger pass in which it did, used to measure how long it stays
+    | idle.
+*/
+void stamp_free_block(struct block_meta *block);
+/*
+    @param block - block that absorbs the next one
+    @param next - block that is absorbed
+
+    | Method called before two adjacent free blocks are merged, that
+    | gives the merged block the stamp it should keep.
+*/
+void merge_stamps(struct block_meta *block, struct block_meta *next);
+/*
+    @param block - mapped block that is freed
+
+    | Method called by free() on a mapped block. If the scavenger is
+    | running, the block is removed from the list and its munmap() is
+    | left to the scavenger thread. Returns 0 if the unmap is not
+    | deferred, in which case the caller unmaps the block.
+*/
+int defer_unmap(struct block_meta *block);
+/*
+    | Method that runs one scavenger pass: it unmaps the pending mapped
+    | blocks and releases the pages of free blocks idle for longer than
+    | the decay interval, within the rate limit and the RSS headroom.
+*/
+void scavenge(void);
+/*
+    @param interval_ms - time between two passes
+    @param decay_ms - time a free block has to stay idle to be released
+    @param headroom - idle free memory that is kept resident
+    @param rate_limit - maximum number of bytes released per pass
+
+    | Starts the scavenger thread, returns -1 on failure.
+*/
+int scavenger_start(unsigned int interval_ms, unsigned int decay_ms, size_t headroom, size_t rate_limit);
+/*
+    | Stops the scavenger thread and unmaps the pending mapped blocks.
+*/
+void scavenger_stop(void);
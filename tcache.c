@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/**
+ * @name Dumitrescu Alexandra
+ * @date 10.04.2023
+ * @for  Operating Systems - Memory Allocator
+ */
+#include <pthread.h>
+#include "tcache.h"
+#include "alignment_utils.h"
+#include "allocator.h"
+#include "scavenger.h"
+#include "meta_table.h"
+
+/**
+ * Lists of cached small blocks of the calling thread
+ */
+__thread struct os_tcache os_tcache;
+/**
+ * Value set once the thread registered the destructor that gives
+ * its cached blocks back to the heap when it exits.
+ */
+__thread int tcache_registered;
+/**
+ * Rest of the chunk the calling thread carves isolated blocks from. It
+ * is a brk() block with STATUS_ALLOC, so no other thread reuses it.
+ */
+__thread struct block_meta *isolated_chunk;
+/**
+ * Freed isolated blocks of the calling thread and their number, one
+ * list for each number of cache lines, linked through their first word
+ */
+__thread void *isolated_cache[ISOLATED_CLASSES];
+__thread unsigned int isolated_count[ISOLATED_CLASSES];
+/**
+ * Size classes whose blocks are isolated, one bit per class
+ */
+unsigned int os_isolated_classes;
+
+/**
+ * The inline pop of os_malloc_small() writes the status of the header
+ */
+_Static_assert(OS_STATUS_ALLOC == STATUS_ALLOC, "Status of popped blocks differs from helpers.h");
+_Static_assert(sizeof(struct block_meta) - offsetof(struct block_meta, status) == OS_STATUS_OFFSET,
+	"Status offset differs from struct block_meta");
+
+/**
+ * Key whose destructor flushes the lists of an exiting thread, created once
+ */
+pthread_key_t tcache_key;
+pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @param arg - lists of the exiting thread
+ *	| Marks every block cached by the exiting thread, its freed isolated
+ *	| blocks and the rest of its isolated chunk as free.
+ */
+static void tcache_flush(void *arg)
+{
+	struct os_tcache *tcache = arg;
+
+	heap_lock();
+	if (isolated_chunk != NULL) {
+		isolated_chunk->status = STATUS_FREE;
+		meta_table_sync(isolated_chunk);
+		stamp_free_block(isolated_chunk);
+		isolated_chunk = NULL;
+	}
+	for (int size_class = 0; size_class < OS_SIZE_CLASSES; size_class++) {
+		void *ptr = tcache->head[size_class];
+
+		while (ptr != NULL) {
+			struct block_meta *block = (struct block_meta *)((char *)ptr - get_block_meta_size());
+
+			ptr = *(void **)ptr;
+			block->status = STATUS_FREE;
+			meta_table_sync(block);
+			stamp_free_block(block);
+		}
+		tcache->head[size_class] = NULL;
+		tcache->count[size_class] = 0;
+	}
+	for (int size_class = 0; size_class < ISOLATED_CLASSES; size_class++) {
+		void *ptr = isolated_cache[size_class];
+
+		while (ptr != NULL) {
+			struct block_meta *block = (struct block_meta *)((char *)ptr - get_block_meta_size());
+
+			ptr = *(void **)ptr;
+			block->status = STATUS_FREE;
+			meta_table_sync(block);
+			stamp_free_block(block);
+		}
+		isolated_cache[size_class] = NULL;
+		isolated_count[size_class] = 0;
+	}
+	heap_unlock();
+}
+
+/**
+ *	| Creates the key whose destructor is tcache_flush().
+ */
+static void tcache_key_create(void)
+{
+	pthread_key_create(&tcache_key, tcache_flush);
+}
+
+/**
+ *	| Registers the destructor that gives the blocks cached by the
+ *	| calling thread back to the heap when it exits.
+ */
+static void tcache_register(void)
+{
+	if (!tcache_registered) {
+		pthread_once(&tcache_once, tcache_key_create);
+		pthread_setspecific(tcache_key, &os_tcache);
+		tcache_registered = 1;
+	}
+}
+
+/**
+ * @param block - alloced brk() block that is freed
+ *	| The block is cached in the largest class that is not larger
+ *	| than its size (A), as long as the list has room (B). It gets
+ *	| STATUS_CACHED, so freeing it again is ignored, and its grow
+ *	| count is reset like for any freed block. The side tables keep
+ *	| its previous status, since the pop doesn't take the lock to sync. (C)
+ */
+int tcache_push(struct block_meta *block)
+{
+	if (block->size < os_class_size[0] || block->size > OS_SMALL_MAX)
+		return 0;
+
+	// (A)
+	unsigned int size_class = os_size_class[(block->size + 7) >> 3];
+
+	if (os_class_size[size_class] > block->size)
+		size_class--;
+
+	// (B)
+	if (os_tcache.count[size_class] >= OS_TCACHE_MAX)
+		return 0;
+
+	tcache_register();
+
+	// (C)
+	void *ptr = (char *)block + get_block_meta_size();
+
+	block->status = STATUS_CACHED;
+	block->grow_count = 0;
+
+	*(void **)ptr = os_tcache.head[size_class];
+	os_tcache.head[size_class] = ptr;
+	os_tcache.count[size_class]++;
+	return 1;
+}
+
+/**
+ * @param size_class - size class of the request
+ *	| Slow path of os_malloc_small(). One chunk large enough for
+ *	| OS_TCACHE_BATCH blocks of the class is reused or added (A) and
+ *	| carved into blocks of the class size (B). The first block is
+ *	| returned and the others are cached for the next requests. (C)
+ */
+void *os_malloc_small_miss(unsigned int size_class)
+{
+	size_t size = os_class_size[size_class];
+	size_t batch_size = OS_TCACHE_BATCH * (size + get_block_meta_size()) - get_block_meta_size();
+
+	heap_lock();
+	// (A)
+	struct block_meta *block = find_best_fit(batch_size);
+
+	if (block == NULL)
+		block = (struct block_meta *)((char *)add_new_alloced_block(batch_size) - get_block_meta_size());
+
+	// (B)
+	struct block_meta *last = block;
+	int carved = 1;
+
+	while (carved < OS_TCACHE_BATCH && last->size > size + get_block_meta_size()) {
+		split_block(last, size);
+		last = last->next;
+		last->status = STATUS_ALLOC;
+		meta_table_sync(last);
+		carved++;
+	}
+	if (last->size > size + get_block_meta_size())
+		split_block(last, size);
+
+	// (C)
+	struct block_meta *ptr = block->next;
+
+	for (int i = 1; i < carved; i++) {
+		struct block_meta *next = ptr->next;
+
+		if (!tcache_push(ptr)) {
+			ptr->status = STATUS_FREE;
+			meta_table_sync(ptr);
+			stamp_free_block(ptr);
+		}
+		ptr = next;
+	}
+	heap_unlock();
+
+	return (char *)block + get_block_meta_size();
+}
+
+/**
+ * @param size - size of an isolated block carved from a chunk
+ *	| Returns the list of freed isolated blocks spanning as many lines.
+ */
+static unsigned int isolated_class(size_t size)
+{
+	return (size + get_block_meta_size()) / CACHE_LINE_SIZE - 2;
+}
+
+/**
+ * @param size - aligned size of the new block
+ *	| The block is given whole cache lines: its payload starts on a
+ *	| line boundary and its size is rounded by isolated_size() (A).
+ *	| Large blocks are alloced directly with that alignment (B). Small
+ *	| ones reuse a block freed by the calling thread with as many lines
+ *	| (E), or are split off the front of the thread's chunk, which
+ *	| keeps the rest alloced for the next requests (C). A new chunk is
+ *	| taken when the current one is too small, the old one is freed (D).
+ *	| The block gets STATUS_ISOLATED, so it is never cached for plain
+ *	| small requests. (F)
+ */
+void *malloc_isolated(size_t size)
+{
+	// (A)
+	size_t block_size = isolated_size(size);
+	struct block_meta *block;
+	void *adr;
+
+	heap_lock();
+	// (B)
+	if (block_size > ISOLATED_CARVE_MAX) {
+		adr = add_new_aligned_block(block_size, CACHE_LINE_SIZE);
+		block = (struct block_meta *)((char *)adr - get_block_meta_size());
+		if (block->status == STATUS_ALLOC) {
+			block->status = STATUS_ISOLATED;
+			meta_table_sync(block);
+		}
+		heap_unlock();
+		return adr;
+	}
+
+	// (E)
+	unsigned int size_class = isolated_class(block_size);
+
+	adr = isolated_cache[size_class];
+	if (adr != NULL) {
+		isolated_cache[size_class] = *(void **)adr;
+		isolated_count[size_class]--;
+		block = (struct block_meta *)((char *)adr - get_block_meta_size());
+		block->status = STATUS_ISOLATED;
+		meta_table_sync(block);
+		heap_unlock();
+		return adr;
+	}
+
+	// (D)
+	if (isolated_chunk == NULL || isolated_chunk->size < block_size) {
+		if (isolated_chunk != NULL) {
+			isolated_chunk->status = STATUS_FREE;
+			meta_table_sync(isolated_chunk);
+			stamp_free_block(isolated_chunk);
+		}
+		adr = add_new_aligned_block(ISOLATED_CHUNK_SIZE - get_block_meta_size(), CACHE_LINE_SIZE);
+		isolated_chunk = (struct block_meta *)((char *)adr - get_block_meta_size());
+		tcache_register();
+	}
+
+	// (C)
+	block = isolated_chunk;
+	if (block->size > block_size + get_block_meta_size()) {
+		split_block(block, block_size);
+		isolated_chunk = block->next;
+		isolated_chunk->status = STATUS_ALLOC;
+		meta_table_sync(isolated_chunk);
+	} else {
+		isolated_chunk = NULL;
+	}
+
+	// (F)
+	block->status = STATUS_ISOLATED;
+	meta_table_sync(block);
+	heap_unlock();
+
+	return (char *)block + get_block_meta_size();
+}
+
+/**
+ * @param block - isolated brk() block that is freed
+ *	| Blocks carved from a chunk are kept in the list of the calling
+ *	| thread with as many lines, with STATUS_CACHED (A). Larger ones,
+ *	| or those finding the list full, become free. (B)
+ */
+void free_isolated_block(struct block_meta *block)
+{
+	// (A)
+	if (block->size <= ISOLATED_CARVE_MAX) {
+		unsigned int size_class = isolated_class(block->size);
+
+		if (isolated_count[size_class] < OS_TCACHE_MAX) {
+			void *ptr = (char *)block + get_block_meta_size();
+
+			tcache_register();
+			block->status = STATUS_CACHED;
+			block->grow_count = 0;
+			*(void **)ptr = isolated_cache[size_class];
+			isolated_cache[size_class] = ptr;
+			isolated_count[size_class]++;
+			return;
+		}
+	}
+
+	// (B)
+	block->status = STATUS_FREE;
+	meta_table_sync(block);
+	stamp_free_block(block);
+}
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+#include "helpers.h"
+#include "osmem_inline.h"
+/*
+    @name Dumitrescu Alexandra
+    @date 10.04.2023
+    @for  Operating Systems - Memory Allocator
+*/
+
+/*
+    @param block - alloced brk() block that is freed
+
+    | Pushes a freed small block to the list of the calling thread,
+    | keeping its status alloced. Returns 0 if the block isn't cached,
+    | in which case the caller frees it.
+*/
+int tcache_push(struct block_meta *block);
+/*
+    @param size - aligned size of the new memory block
+
+    | Allocates a block isolated on its own cache lines. Small blocks are
+    | carved from a chunk owned by the calling thread.
+*/
+void *malloc_isolated(size_t size);
+/*
+    @param block - isolated brk() block
+
+    | Frees a block alloced by malloc_isolated(), keeping small ones for
+    | the next isolated requests of the calling thread.
+*/
+void free_isolated_block(struct block_meta *block);